@@ -9,5 +9,10 @@ bool uopen (int uid, SERIAL_CONFIG *sc);
 void uclose (int uid);
 int uread (char *ptr, int size, int nmemb, int uid);
 int uwrite (const char *ptr, int size, int nmemb, int uid);
+int uhiwater (int uid, bool bTx);
+int uoverrun (int uid);
+int uidle (int uid);
+int urxdata (int uid, char **pptr);
+void urxdone (int uid, int nbyte);
 
 #endif
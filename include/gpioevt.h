@@ -0,0 +1,38 @@
+// gpioevt.h - Interrupt driven GPIO edge events for BASIC
+
+#ifndef GPIOEVT_H
+#define GPIOEVT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef GEVT_LEN
+#define GEVT_LEN    64                  // Length of event ring (must be a power of 2)
+#endif
+
+#define WM_GPIO     0x8001              // @msg% for GPIO events delivered to ON SYS
+
+typedef struct
+    {
+    uint32_t    time;                   // Time of interrupt (microseconds)
+    uint8_t     pin;                    // GPIO number
+    uint8_t     edge;                   // GPIO_IRQ_EDGE_FALL and / or GPIO_IRQ_EDGE_RISE
+    uint16_t    spare;
+    } GPIO_EVENT;
+
+typedef struct
+    {
+    uint32_t    nevent;                 // Events recorded by the interrupt
+    uint32_t    nlost;                  // Events lost because the ring was full
+    uint32_t    ndone;                  // Events passed to BASIC
+    uint32_t    tlat;                   // Total latency, interrupt to BASIC (microseconds)
+    uint32_t    tmax;                   // Longest latency (microseconds)
+    } GPIO_EVT_STATS;
+
+bool gpio_event_enable (int pin, int edges);            // Edges zero to disable
+bool gpio_event_get (GPIO_EVENT *pevt);                 // Poll for an event, false if none
+void gpio_event_stats (GPIO_EVT_STATS *ps);
+void gpio_event_reset (void);
+void gpio_event_post (void);                            // Pass events to ON SYS handler
+
+#endif
@@ -3,8 +3,30 @@
 #ifndef PERIODIC_H
 #define PERIODIC_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef NPRD
+#define NPRD        8                   // Maximum number of periodic tasks
+#endif
+
+#ifndef PRD_TICK_US
+#define PRD_TICK_US 1000                // Scheduler tick (microseconds)
+#endif
+
 typedef void (*PRD_FUNC)(void);
 
-PRD_FUNC add_periodic (PRD_FUNC new);
+typedef struct
+    {
+    uint32_t    nrun;                   // Number of times run
+    uint32_t    tused;                  // Total run time (microseconds)
+    uint32_t    tmax;                   // Longest single run (microseconds)
+    uint32_t    nover;                  // Number of periods missed
+    } PRD_STATS;
+
+int add_periodic (PRD_FUNC fn, int period, int prio);   // Period in ms, lower prio runs first. Returns id or -1
+void remove_periodic (int id);
+bool periodic_stats (int id, PRD_STATS *ps);            // Copy counters for a task, false if not in use
+void periodic_reset (int id);                           // Clear counters for a task
 
 #endif
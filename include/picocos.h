@@ -3,8 +3,16 @@
 #ifndef PICOCOS_H
 #define PICOCOS_H
 
-// Work around out of order output when using Pico printf
-#define printf(...) fprintf (stdout, __VA_ARGS__)
+// Send console output through the buffer in bbpico.c, so that printf
+// and putchar output stays in order
+void conflush (void);
+int conputc (int c);
+int conprintf (const char *psFmt, ...);
+
+#undef putchar
+#define printf(...) conprintf (__VA_ARGS__)
+#define putchar(c)  conputc (c)
+#define fflush(f)   (((f) == stdout) ? (conflush (), 0) : fflush (f))
 
 // Rename oscli so that Pico can add additional star commands
 
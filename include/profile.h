@@ -0,0 +1,14 @@
+// profile.h - Statement-level execution profiler
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+
+extern bool bProfile;
+
+void profile_stmt (signed char *site);
+void profile_on (void);
+void profile_report (int nlines, const char *path);
+
+#endif
@@ -13,6 +13,9 @@ typedef struct
     int     rx;
     int     cts;
     int     rts;
+    int     rxbuf;      // Receive ring length (bytes)
+    int     txbuf;      // Transmit ring length (bytes)
+    int     dma;        // Non-zero to receive using DMA
     } SERIAL_CONFIG;
 
 #endif
@@ -0,0 +1,29 @@
+// scrnrle.h - Run length compressed screen save files
+
+#ifndef SCRNRLE_H
+#define SCRNRLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef SRLE_BUF
+#define SRLE_BUF    512                 // Size of file buffer
+#endif
+
+typedef struct
+    {
+    FILE    *f;                         // File being written or read
+    int     n;                          // Number of bytes in buffer
+    int     i;                          // Read position in buffer
+    uint8_t buf[SRLE_BUF];
+    } SRLE;
+
+bool srle_ext (const char *path);
+int srle_wrhdr (SRLE *ps, FILE *f, int wth, int hgt, int nbit, int nclr, const int *prgb);
+int srle_wrrow (SRLE *ps, const uint8_t *prow, int nbyte);
+int srle_wrend (SRLE *ps);
+int srle_rdhdr (SRLE *ps, FILE *f, int wth, int hgt, int nbit, int nclr, int *prgb);
+int srle_rdrow (SRLE *ps, uint8_t *prow, int nbyte);
+
+#endif
@@ -0,0 +1,117 @@
+// spscq.h - Single producer, single consumer queue
+
+/*  A ring of fixed size items, safe without locking provided only one context
+    puts and only one context gets. The number of items must be a power of 2.
+    The read and write counts run freely, so all of the items may be used.
+    Items which will not fit are counted as dropped.
+*/
+
+#ifndef SPSCQ_H
+#define SPSCQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct
+    {
+    uint8_t             *data;          // Item storage
+    uint32_t            mask;           // Number of items - 1
+    uint32_t            isize;          // Size of each item (bytes)
+    volatile uint32_t   rcnt;           // Items read (advanced by consumer)
+    volatile uint32_t   wcnt;           // Items written (advanced by producer)
+    volatile uint32_t   ndrop;          // Items dropped because queue full
+    } SPSCQ;
+
+// Static initialiser:
+#define SPSCQ_INIT(data, nitem, isize)  { (uint8_t *) (data), (nitem) - 1, (isize), 0, 0, 0 }
+
+static inline void spscq_init (SPSCQ *q, void *data, uint32_t nitem, uint32_t isize)
+    {
+    q->data = (uint8_t *) data;
+    q->mask = nitem - 1;
+    q->isize = isize;
+    q->rcnt = 0;
+    q->wcnt = 0;
+    q->ndrop = 0;
+    }
+
+static inline uint32_t spscq_count (const SPSCQ *q)
+    {
+    return q->wcnt - q->rcnt;
+    }
+
+static inline uint32_t spscq_free (const SPSCQ *q)
+    {
+    return q->mask + 1 - ( q->wcnt - q->rcnt );
+    }
+
+static inline bool spscq_put (SPSCQ *q, const void *pitem)
+    {
+    uint32_t wcnt = q->wcnt;
+    if ( wcnt - q->rcnt > q->mask )
+        {
+        ++q->ndrop;
+        return false;
+        }
+    memcpy (q->data + ( wcnt & q->mask ) * q->isize, pitem, q->isize);
+    __atomic_store_n (&q->wcnt, wcnt + 1, __ATOMIC_RELEASE);
+    return true;
+    }
+
+static inline bool spscq_get (SPSCQ *q, void *pitem)
+    {
+    uint32_t rcnt = q->rcnt;
+    if ( __atomic_load_n (&q->wcnt, __ATOMIC_ACQUIRE) == rcnt ) return false;
+    memcpy (pitem, q->data + ( rcnt & q->mask ) * q->isize, q->isize);
+    __atomic_store_n (&q->rcnt, rcnt + 1, __ATOMIC_RELEASE);
+    return true;
+    }
+
+// Copy the next item without removing it (consumer only):
+static inline bool spscq_peek (SPSCQ *q, void *pitem)
+    {
+    uint32_t rcnt = q->rcnt;
+    if ( __atomic_load_n (&q->wcnt, __ATOMIC_ACQUIRE) == rcnt ) return false;
+    memcpy (pitem, q->data + ( rcnt & q->mask ) * q->isize, q->isize);
+    return true;
+    }
+
+// Copy the item n places from the front without removing it (consumer only):
+static inline bool spscq_peekn (SPSCQ *q, uint32_t n, void *pitem)
+    {
+    uint32_t rcnt = q->rcnt;
+    if ( __atomic_load_n (&q->wcnt, __ATOMIC_ACQUIRE) - rcnt <= n ) return false;
+    memcpy (pitem, q->data + (( rcnt + n ) & q->mask ) * q->isize, q->isize);
+    return true;
+    }
+
+// Discard the first n items (consumer only, n no more than the count):
+static inline void spscq_skip (SPSCQ *q, uint32_t n)
+    {
+    __atomic_store_n (&q->rcnt, q->rcnt + n, __ATOMIC_RELEASE);
+    }
+
+// Discard everything queued (consumer only):
+static inline void spscq_flush (SPSCQ *q)
+    {
+    q->rcnt = q->wcnt;
+    }
+
+// For filling in bulk, the free space up to the end of the ring. Returns NULL if full:
+static inline void *spscq_wrptr (SPSCQ *q, uint32_t *pnitem)
+    {
+    uint32_t wcnt = q->wcnt;
+    uint32_t nfree = q->mask + 1 - ( wcnt - q->rcnt );
+    uint32_t nend = q->mask + 1 - ( wcnt & q->mask );
+    if ( nfree == 0 ) return NULL;
+    *pnitem = ( nfree < nend ) ? nfree : nend;
+    return q->data + ( wcnt & q->mask ) * q->isize;
+    }
+
+static inline void spscq_wrdone (SPSCQ *q, uint32_t nitem)
+    {
+    __atomic_store_n (&q->wcnt, q->wcnt + nitem, __ATOMIC_RELEASE);
+    }
+
+#endif
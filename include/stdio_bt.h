@@ -4,10 +4,12 @@
 #define STDIO_BT_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <pico/stdio/driver.h>
 
 extern stdio_driver_t stdio_bt;
 void stdio_bt_init (void);
 bool stdio_bt_connected (void);
+void stdio_bt_stats (uint32_t *pnbytes, uint32_t *pnpkts, uint32_t *pnwaits);    // Output throughput counters
 
 #endif
@@ -0,0 +1,23 @@
+// varcache.h - Per-site cache of resolved variable addresses
+
+#ifndef VARCACHE_H
+#define VARCACHE_H
+
+#include <stdbool.h>
+
+typedef struct
+    {
+    unsigned int    hits;       // Lookups satisfied from the cache
+    unsigned int    misses;     // Lookups passed to the variable chain search
+    unsigned int    fills;      // Cache entries created
+    unsigned int    flushes;    // Cache invalidations (CLEAR, RUN, edit etc.)
+    } VCSTATS;
+
+extern VCSTATS vcstats;
+extern bool bVarCache;
+
+void *getvar_vc (unsigned char *ptype);
+void *getput_vc (unsigned char *ptype);
+void varcache_flush (void);
+
+#endif
@@ -112,6 +112,12 @@ int vtint (int xp, int yp);             // Get RGB value at position in graphics
 int vgetc (int x, int y);               // Get character at position (in characters) relative to viewport
 int widths (unsigned char *s, int l);   // Length in graphics units of string of length l
 void xeqvdu (int code, int data1, int data2);       // Execute VDU command with parameters
+#ifdef VDU_CORE1
+void vdustart (void);                   // Start executing VDU commands on core 1
+void vdufence (void);                   // Wait for VDU commands queued to core 1 to complete
+void vdupaged (void);                   // Before reading the keyboard, complete any paged mode wait
+void vduflashcsr (void);                // Flash the cursor, unless core 1 is drawing
+#endif
 bool txtmode (int code, int *pdata1, int *pdata2);  // Get definition of a mode
 #if REF_MODE & 2
 void vduflush (void);
@@ -129,6 +135,10 @@ void refresh_off (void);
 void refresh (const char *p);
 #endif
 void prtscrn (void);
+void sprite_define (int n, int w, int h, int key, const void *bits);
+void sprite_show (int n, int x, int y, int op);
+void sprite_hide (int n);
+void sprite_clear (void);
 #ifdef PICO_GUI
 void copyedit (bool bEnable);
 void copymove (int key);
@@ -141,16 +151,26 @@ const MODE *setmode (int mode);
 void dispenable (void);
 void hidecsr (void);
 void showcsr (void);
+void flashcsr (void);
 void enablecsr (bool bEnable);
 void scrldn (void);
 void scrlup (void);
 void cls ();
 void disp_ttx (char chr);
 void disp_glyph (uint8_t *pch);
+void newglyph (void);
 void point (int clrop, uint32_t xp, uint32_t yp);
 void hline (int clrop, int xp1, int xp2, int yp);
+void hspan (int clrop, int xp1, int xp2, int yp);
+void rectout (int xp1, int yp1, int xp2, int yp2);
+void hlbatch (bool bBatch);
 void clrgraph (void);
 uint8_t getpix (int xp, int yp);
+int fillscan (int xp, int yp, int xlim, uint32_t inset);
+const char *sprdef (int n, int w, int h, int key, const uint8_t *bits);
+void sprshow (int n, int xp, int yp, int op);
+void sprhide (int n);
+void sprclear (void);
 int get_ttx (int x, int y);
 void get_glyph (int x, int y, uint8_t *prow);
 void gsize (uint32_t *pwth, uint32_t *phgt);
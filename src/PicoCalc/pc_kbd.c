@@ -1,14 +1,35 @@
-/* pc_kbd.c - Poll for keyboard events from the PicoCalc MCU via I2C */
+/* pc_kbd.c - Poll for keyboard events from the PicoCalc MCU via I2C
+
+    Polling is driven by the I2C interrupt and an alarm, so never waits for the bus.
+    The alarm starts a transaction by queuing the request and read commands in the
+    I2C FIFO. When the two byte response arrives the interrupt decodes it and sets
+    the alarm for the next poll, PC_KBD_POLL_US after the start of this one. If no
+    response arrives within PC_KBD_TMO_US the transaction is aborted.
+
+    Each key press and release is recorded, with the time its report arrived, in a
+    queue which may be read by kbd_event. The interrupt is the only writer.
+*/
 
-#include "periodic.h"
 #include "picocli.h"
+#include "spscq.h"
 #include <hardware/gpio.h>
 #include <hardware/i2c.h>
+#include <hardware/irq.h>
+#include <pico/time.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
 
-#define FAST    1
+#ifndef PC_KBD_POLL_US
+#define PC_KBD_POLL_US  1000            // Minimum interval between keyboard polls
+#endif
+#ifndef PC_KBD_TMO_US
+#define PC_KBD_TMO_US   20000           // Time allowed for a response
+#endif
+#define PC_KBD_MIN_US   50              // Shortest alarm delay
+#ifndef KBD_EVT_LEN
+#define KBD_EVT_LEN     32              // Length of key event queue (must be a power of 2)
+#endif
 
 #define KEY_ALT         0xA1
 #define KEY_SHL         0xA2
@@ -102,6 +123,14 @@ typedef struct
     uint8_t to;
     } KEYMAP;
 
+typedef struct
+    {
+    uint32_t time;                      // Time report received (microseconds)
+    uint8_t  key;                       // Key code from the keyboard MCU
+    uint8_t  down;                      // 1 = pressed, 0 = released
+    uint16_t spare;
+    } KBD_EVENT;
+
 static const KEYMAP pc_kmap[] =
     {
     {0x08, KNO_BACK},       // Backspace
@@ -233,6 +262,13 @@ static volatile uint8_t  pc_req = 0;
 static volatile uint8_t  pc_dat = 0;
 static bool     bInReq = false;
 static CLIFUNC  excli = NULL;
+static volatile bool bBusy = false;     // Transaction in progress
+static alarm_id_t kbd_alarm = 0;
+static uint32_t tstart;                 // Time current transaction started
+static uint32_t npoll = 0;              // Responses received
+static uint32_t nerr = 0;               // Transactions aborted or timed out
+static KBD_EVENT kbd_evbuf[KBD_EVT_LEN];
+static SPSCQ kbd_evq = SPSCQ_INIT (kbd_evbuf, KBD_EVT_LEN, sizeof (KBD_EVENT));
 
 bool bPrtScrn = false;
 
@@ -253,12 +289,10 @@ static void pc_kbd_init (void)
     // uint8_t test;
     // int stat = i2c_read_blocking (I2C_INSTANCE(PICO_KEYBOARD_I2C), PICO_KEYBOARD_ADDR, &test, 1, false);
     // printf ("I2C Status = %d\n", stat);
-#if FAST
     i2c_inst_t *i2c = I2C_INSTANCE(PICO_KEYBOARD_I2C);
     i2c->hw->enable = 0;
     i2c->hw->tar = PICO_KEYBOARD_ADDR;
     i2c->hw->enable = 1;
-#endif
     }
 
 static void pc_lcd_backlight (uint8_t bright)
@@ -275,8 +309,6 @@ static void pc_lcd_backlight (uint8_t bright)
     // printf ("nrd = %d, rpl = %d, %d\n", nrd, rpl[0], rpl[1]);
     }
 
-static PRD_FUNC pnext = NULL;
-
 static uint8_t mapkey (const KEYMAP *map, int n2, uint8_t key)
     {
     int n1 = -1;
@@ -445,117 +477,154 @@ static uint8_t asc_key (uint8_t key)
     return key;
     }
 
-static void pc_kbd_poll (void)
+// Decode a response:
+static void pc_kbd_msg (const uint8_t *msg)
     {
-    uint8_t msg[2];
-#if FAST
-    i2c_inst_t *i2c = I2C_INSTANCE(PICO_KEYBOARD_I2C);
-    bool txempty = i2c->hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_EMPTY_BITS;
-    size_t nrd = i2c_get_hw(i2c)->rxflr;
-    if (txempty && (nrd >= 2))
+    if (bInReq)
         {
-        while (nrd > 2)
-            {
-            uint32_t dump = i2c_get_hw(i2c)->data_cmd;
-            --nrd;
-            }
-        msg[0] = (uint8_t) i2c_get_hw(i2c)->data_cmd;
-        msg[1] = (uint8_t) i2c_get_hw(i2c)->data_cmd;
-#else
-    int nrd = i2c_read_timeout_us(I2C_INSTANCE(PICO_KEYBOARD_I2C), PICO_KEYBOARD_ADDR, msg, 2, false, 10000);
-    if (nrd == 2)
+        // Assume always a 2 byte response, with data in second byte.
+        pc_dat = msg[1];
+        pc_req = 0;
+        bInReq = false;
+        }
+    else
         {
-#endif
-        if (bInReq)
+        uint8_t key = msg[1];
+        // printf ("kbd status = (0x%02X, 0x%02X)\n", msg[0], msg[1]);
+        if ((msg[0] == 1) || (msg[0] == 3))
             {
-            // Assume always a 2 byte response, with data in second byte.
-            pc_dat = msg[1];
-            pc_req = 0;
-            bInReq = false;
+            KBD_EVENT evt = { time_us_32 (), key, (msg[0] == 1), 0 };
+            spscq_put (&kbd_evq, &evt);
             }
-        else
+        if (msg[0] == 1)
             {
-            uint8_t key = msg[1];
-            // printf ("kbd status = (0x%02X, 0x%02X)\n", msg[0], msg[1]);
-            if (msg[0] == 1)
+            // Key down
+            if (key == KEY_BREAK)
                 {
-                // Key down
-                if (key == KEY_BREAK)
-                    {
-                    flags |= ESCFLG;
-                    }
-                else if ((key >= KEY_ALT) && (key <= KEY_CTRL))
-                    {
-                    key_state[0] |= 1 << (key - KEY_ALT);
-                    }
-                else if (key == KEY_CAPS_LOCK)
-                    {
-                    key_state[0] ^= MOD_CAPLOCK;
-                    }
-                else
-                    {
-                    key = key_no (key);
-                    if (key < KNO_COUNT)
-                        {
-                        key_down (key);
-                        key = asc_key (key);
-                        if (key > 0) putkey (key);
-                        }
-                    }
+                flags |= ESCFLG;
                 }
-            else if (msg[0] == 3)
+            else if ((key >= KEY_ALT) && (key <= KEY_CTRL))
                 {
-                // Key up
-                if (key == KEY_BREAK)
-                    {
-                    }
-                else if ((key >= KEY_ALT) && (key <= KEY_CTRL))
-                    {
-                    key_state[0] &= ~(1 << (key - KEY_ALT));
-                    }
-                else if (key == KEY_CAPS_LOCK)
-                    {
-                    }
-                else
+                key_state[0] |= 1 << (key - KEY_ALT);
+                }
+            else if (key == KEY_CAPS_LOCK)
+                {
+                key_state[0] ^= MOD_CAPLOCK;
+                }
+            else
+                {
+                key = key_no (key);
+                if (key < KNO_COUNT)
                     {
-                    key = key_no (key);
-                    if (key < KNO_COUNT) key_up (key);
+                    key_down (key);
+                    key = asc_key (key);
+                    if (key > 0) putkey (key);
                     }
                 }
             }
-        }
-#if FAST
-    if (txempty)
-        {
-        if (pc_req > 0)
-            {
-            i2c->hw->data_cmd = pc_req;
-            if (pc_req & 0x80) i2c->hw->data_cmd = pc_dat;
-            bInReq = true;
-            }
-        else
+        else if (msg[0] == 3)
             {
-            // Request keyboard status
-            i2c->hw->data_cmd = 0x09;
+            // Key up
+            if (key == KEY_BREAK)
+                {
+                }
+            else if ((key >= KEY_ALT) && (key <= KEY_CTRL))
+                {
+                key_state[0] &= ~(1 << (key - KEY_ALT));
+                }
+            else if (key == KEY_CAPS_LOCK)
+                {
+                }
+            else
+                {
+                key = key_no (key);
+                if (key < KNO_COUNT) key_up (key);
+                }
             }
-        i2c->hw->data_cmd = I2C_IC_DATA_CMD_CMD_BITS;
-        i2c->hw->data_cmd = I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_STOP_BITS;
         }
-#else
+    }
+
+// Queue a request and the read of its response:
+static void pc_kbd_start (void)
+    {
+    i2c_inst_t *i2c = I2C_INSTANCE(PICO_KEYBOARD_I2C);
+    tstart = time_us_32 ();
+    bBusy = true;
     if (pc_req > 0)
         {
-        i2c_write_timeout_us(I2C_INSTANCE(PICO_KEYBOARD_I2C), PICO_KEYBOARD_ADDR, &pc_req, 1, false, 10000);
-        if (pc_req & 0x80) i2c_write_timeout_us(I2C_INSTANCE(PICO_KEYBOARD_I2C), PICO_KEYBOARD_ADDR, &pc_dat, 1, false, 10000);
+        i2c->hw->data_cmd = pc_req;
+        if (pc_req & 0x80) i2c->hw->data_cmd = pc_dat;
         bInReq = true;
         }
     else
         {
-        uint8_t req = 0x09;
-        int nwr = i2c_write_timeout_us(I2C_INSTANCE(PICO_KEYBOARD_I2C), PICO_KEYBOARD_ADDR, &req, 1, false, 10000);
-        // printf ("nwr = %d\n", nwr);
+        // Request keyboard status
+        i2c->hw->data_cmd = 0x09;
         }
-#endif
-    if (pnext) pnext();
+    i2c->hw->data_cmd = I2C_IC_DATA_CMD_CMD_BITS;
+    i2c->hw->data_cmd = I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_STOP_BITS;
+    }
+
+// Start the next poll when due, or abort a transaction which has taken too long:
+static int64_t pc_kbd_alarm (alarm_id_t id, void *user_data)
+    {
+    if (bBusy)
+        {
+        // Counted when the abort interrupt arrives
+        I2C_INSTANCE(PICO_KEYBOARD_I2C)->hw->enable = I2C_IC_ENABLE_ENABLE_BITS | I2C_IC_ENABLE_ABORT_BITS;
+        return PC_KBD_TMO_US;   // Abort again if no interrupt results
+        }
+    pc_kbd_start ();
+    return PC_KBD_TMO_US;
+    }
+
+static void pc_kbd_irq (void)
+    {
+    i2c_hw_t *hw = I2C_INSTANCE(PICO_KEYBOARD_I2C)->hw;
+    if (hw->intr_stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS)
+        {
+        (void) hw->clr_tx_abrt;
+        while (hw->rxflr > 0) (void) hw->data_cmd;
+        // A failed request is retried by the next poll
+        bInReq = false;
+        ++nerr;
+        }
+    else if (hw->rxflr >= 2)
+        {
+        uint8_t msg[2];
+        msg[0] = (uint8_t) hw->data_cmd;
+        msg[1] = (uint8_t) hw->data_cmd;
+        ++npoll;
+        pc_kbd_msg (msg);
+        }
+    else
+        {
+        return;
+        }
+    bBusy = false;
+    if (kbd_alarm > 0) cancel_alarm (kbd_alarm);
+    int32_t tdelay = PC_KBD_POLL_US - (int32_t)(time_us_32 () - tstart);
+    if (tdelay < PC_KBD_MIN_US) tdelay = PC_KBD_MIN_US;
+    kbd_alarm = add_alarm_in_us (tdelay, pc_kbd_alarm, NULL, true);
+    }
+
+// Polls completed and transactions failed:
+void pc_kbd_stats (uint32_t *pnpoll, uint32_t *pnerr)
+    {
+    *pnpoll = npoll;
+    *pnerr = nerr;
+    }
+
+// Next timestamped key transition, false if none:
+bool kbd_event (KBD_EVENT *pevt)
+    {
+    return spscq_get (&kbd_evq, pevt);
+    }
+
+// Number of key transitions lost because the queue was full:
+int kbd_event_drops (void)
+    {
+    return kbd_evq.ndrop;
     }
 
 int testkey (int key)
@@ -623,6 +692,11 @@ void setup_keyboard (void)
     {
     pc_kbd_init();
     pc_lcd_backlight (128);
-    pnext = add_periodic (pc_kbd_poll);
+    i2c_hw_t *hw = I2C_INSTANCE(PICO_KEYBOARD_I2C)->hw;
+    hw->rx_tl = 1;      // Interrupt when both response bytes received
+    hw->intr_mask = I2C_IC_INTR_MASK_M_RX_FULL_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+    irq_set_exclusive_handler (I2C0_IRQ + PICO_KEYBOARD_I2C, pc_kbd_irq);
+    irq_set_enabled (I2C0_IRQ + PICO_KEYBOARD_I2C, true);
+    kbd_alarm = add_alarm_in_us (PC_KBD_POLL_US, pc_kbd_alarm, NULL, true);
     excli = add_cli (pc_cli);
     }
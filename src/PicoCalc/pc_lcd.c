@@ -12,6 +12,7 @@
 #include "vducmd.h"
 #include "periodic.h"
 #include "qspi.h"
+#include "scrnrle.h"
 
 #include "font_tt.h"
 
@@ -45,7 +46,6 @@ RFM rfm = rfmBuffer;
 #endif
 
 static void ttx_cls (void);
-static void video_periodic (void);
 
 #include "pico/binary_info.h"
 bi_decl (bi_1pin_with_name (PICO_LCD_DC_PIN,    "LCD command / data"));
@@ -139,9 +139,7 @@ static bool bBlink = false;
 
 static bool bCsrVis = false;
 static int nCsrHide = 0;
-static uint32_t nFlash = 0;             // Time counter for cursor flash
 static critical_section_t cs_csr;       // Critical section controlling cursor flash
-static PRD_FUNC pnext = NULL;
 
 #if REF_MODE & 1
 static int nRowBeg = 0;
@@ -530,7 +528,11 @@ void setup_vdu (void)
     LCD_DataTerm ();
 
     critical_section_init (&cs_csr);
-    pnext = add_periodic (video_periodic);
+#ifdef VDU_CORE1
+    add_periodic (vduflashcsr, 500, 2);
+#else
+    add_periodic (flashcsr, 500, 2);
+#endif
 
     modechg (8);
     }
@@ -1230,6 +1232,11 @@ void disp_glyph (uint8_t *pch)
     Dsp_DataTerm ();
     }
 
+// Character definitions changed - glyphs are not cached for this display:
+void newglyph (void)
+    {
+    }
+
 static inline void pixop (int op, uint16_t *fb, uint16_t cpx)
     {
     switch (op)
@@ -1294,6 +1301,21 @@ void hline (int clrop, int xp1, int xp2, int yp)
         }
     }
 
+// Spans are always drawn directly, so there is no separate display update:
+void hspan (int clrop, int xp1, int xp2, int yp)
+    {
+    hline (clrop, xp1, xp2, yp);
+    }
+
+void rectout (int xp1, int yp1, int xp2, int yp2)
+    {
+    }
+
+// Merge updates for consecutive spans - not needed as spans are drawn directly:
+void hlbatch (bool bBatch)
+    {
+    }
+
 void point (int clrop, uint32_t xp, uint32_t yp)
     {
     hline (clrop, xp, xp, yp);
@@ -1340,6 +1362,37 @@ uint8_t getpix (int xp, int yp)
     return findclr (getcolour (xp, yp));
     }
 
+// Count the run of pixels from xp towards xlim with colours in the set inset:
+int fillscan (int xp, int yp, int xlim, uint32_t inset)
+    {
+    int dx = ( xlim >= xp ) ? 1 : -1;
+    int n = 0;
+    while (( xp != xlim + dx ) && ( inset & (1 << getpix (xp, yp)) ))
+        {
+        xp += dx;
+        ++n;
+        }
+    return n;
+    }
+
+// Sprites are only implemented for framebuffer displays
+const char *sprdef (int n, int w, int h, int key, const uint8_t *bits)
+    {
+    return "Sprites not supported";
+    }
+
+void sprshow (int n, int xp, int yp, int op)
+    {
+    }
+
+void sprhide (int n)
+    {
+    }
+
+void sprclear (void)
+    {
+    }
+
 int get_ttx (int x, int y)
     {
     int chr = ttx_disp[y].ch[x];
@@ -1493,16 +1546,6 @@ void enablecsr (bool bEnable)
     else            nCsrHide |= CSR_OFF;
     }
 
-static void video_periodic (void)
-    {
-    if ( ++nFlash >= 5 )
-        {
-        flashcsr ();
-        nFlash = 0;
-        }
-    if (pnext) pnext ();
-    }
-
 void gsize (uint32_t *pwth, uint32_t *phgt)
     {
     *pwth = SWIDTH;
@@ -1575,10 +1618,69 @@ int sload (FILE *fBmp)
     if (iOff > 0) fseek (fBmp, iOff, SEEK_SET);
     for (int iRow = pmode->grow - 1; iRow >= 0 ; --iRow)
         {
-        Dsp_SetWindow (0, iRow, pmode->gcol, iRow + 1);
-        Dsp_DataOutput ();
         nRead = fread (pBuff, 1, pmode->gcol, fBmp);
         if (nRead != pmode->gcol) return 255;
+        for (int iCol = 0; iCol < pmode->gcol; ++iCol)
+            {
+            if (pBuff[iCol] >= nClr) return 255;
+            }
+        Dsp_SetWindow (0, iRow, pmode->gcol, iRow + 1);
+        Dsp_DataOutput ();
+        for (int iCol = 0; iCol < pmode->gcol; ++iCol)
+            {
+            Dsp_WriteColour (curpal[pBuff[iCol]], 1);
+            }
+        Dsp_DataTerm ();
+        }
+    return 0;
+    }
+
+// Save the screen as a run length compressed file, one byte (colour number) per pixel:
+int sdumprle (FILE *fRle)
+    {
+    SRLE srle;
+    int rgb[16];
+    uint8_t pBuff[320];
+    int nClr = 1 << pmode->ncbt;
+    for (int iClr = 0; iClr < nClr; ++iClr) rgb[iClr] = clrrgb (iClr);
+    int iErr = srle_wrhdr (&srle, fRle, pmode->gcol, pmode->grow, 8, nClr, rgb);
+    for (int iRow = 0; ( iErr == 0 ) && ( iRow < pmode->grow ); ++iRow)
+        {
+        Dsp_SetWindow (0, iRow, pmode->gcol, iRow + 1);
+        Dsp_DataInput ();
+        for (int iCol = 0; iCol < pmode->gcol; ++iCol)
+            {
+            pBuff[iCol] = findclr (Dsp_ReadColour ());
+            }
+        Dsp_DataTerm ();
+        iErr = srle_wrrow (&srle, pBuff, pmode->gcol);
+        }
+    if ( iErr == 0 ) iErr = srle_wrend (&srle);
+    return iErr;
+    }
+
+int sloadrle (FILE *fRle)
+    {
+    SRLE srle;
+    int rgb[16];
+    uint8_t pBuff[320];
+    int nClr = 1 << pmode->ncbt;
+    int iErr = srle_rdhdr (&srle, fRle, pmode->gcol, pmode->grow, 8, nClr, rgb);
+    if ( iErr ) return iErr;
+    for (int iClr = 0; iClr < nClr; ++iClr)
+        {
+        clrset (iClr, 16, rgb[iClr] & 0xFF, (rgb[iClr] >> 8) & 0xFF, (rgb[iClr] >> 16) & 0xFF);
+        }
+    for (int iRow = 0; iRow < pmode->grow; ++iRow)
+        {
+        iErr = srle_rdrow (&srle, pBuff, pmode->gcol);
+        if ( iErr ) return iErr;
+        for (int iCol = 0; iCol < pmode->gcol; ++iCol)
+            {
+            if ( pBuff[iCol] >= nClr ) return 255;
+            }
+        Dsp_SetWindow (0, iRow, pmode->gcol, iRow + 1);
+        Dsp_DataOutput ();
         for (int iCol = 0; iCol < pmode->gcol; ++iCol)
             {
             Dsp_WriteColour (curpal[pBuff[iCol]], 1);
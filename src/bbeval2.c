@@ -19,7 +19,11 @@
 #include <math.h>
 #include <errno.h>
 #include <setjmp.h>
+#include <stdbool.h>
 #include "BBC.h"
+#ifdef VAR_CACHE
+#include "varcache.h"
+#endif
 
 #if defined __arm__ || defined __aarch64__ || defined __EMSCRIPTEN__
 #define powl pow
@@ -121,6 +125,321 @@ static void *getvbr(unsigned char *ptype)
 	return getvar (ptype);
     }
 
+#if defined __arm__ || defined __aarch64__ || defined __EMSCRIPTEN__
+// Fast conversion of numbers to decimal, used in place of sprintf where the
+// result can be computed exactly using 64 and 128-bit integer arithmetic.
+// Digits are correctly rounded (half to even) from the binary value, as
+// by sprintf, so the output is identical. Otherwise fstr returns -1 and
+// the number is formatted by sprintf.
+
+#define FSTR_MAXDIG 17  // Maximum number of significant digits
+#define FSTR_MAXP5  27  // Largest power of 5 fitting in 63 bits
+
+static const unsigned long long pow10ll[19] = {1ULL, 10ULL, 100ULL, 1000ULL,
+    10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+    10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL};
+
+static const unsigned long long pow5ll[FSTR_MAXP5 + 1] = {1ULL, 5ULL, 25ULL,
+    125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL, 390625ULL, 1953125ULL,
+    9765625ULL, 48828125ULL, 244140625ULL, 1220703125ULL, 6103515625ULL,
+    30517578125ULL, 152587890625ULL, 762939453125ULL, 3814697265625ULL,
+    19073486328125ULL, 95367431640625ULL, 476837158203125ULL,
+    2384185791015625ULL, 11920928955078125ULL, 59604644775390625ULL,
+    298023223876953125ULL, 1490116119384765625ULL, 7450580596923828125ULL};
+
+// Write 'ndig' decimal digits (with leading zeros) of a value < 10^9:
+static char *digits9 (char *p, unsigned int n, int ndig)
+    {
+    char *q = p + ndig;
+    while (q > p)
+        {
+        *--q = '0' + n % 10;
+        n /= 10;
+        }
+    return p + ndig;
+    }
+
+// Write an unsigned 64-bit integer in decimal, returning its length:
+static int ulltodec (unsigned long long n, char *dst)
+    {
+    char *p = dst;
+    if (n >= 1000000000ULL)
+        {
+        unsigned long long h = n / 1000000000ULL;
+        unsigned int l = (unsigned int)(n - h * 1000000000ULL);
+        p += ulltodec (h, p);
+        p = digits9 (p, l, 9);
+        }
+    else
+        {
+        unsigned int m = (unsigned int) n;
+        int nd = 1;
+        while ((nd < 9) && (m >= pow10ll[nd])) ++nd;
+        p = digits9 (p, m, nd);
+        }
+    *p = '\0';
+    return p - dst;
+    }
+
+// 64 x 64 -> 128 bit multiply:
+static void mul64x64 (unsigned long long a, unsigned long long b,
+    unsigned long long *phi, unsigned long long *plo)
+    {
+    unsigned long long a0 = (unsigned int) a, a1 = a >> 32;
+    unsigned long long b0 = (unsigned int) b, b1 = b >> 32;
+    unsigned long long p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+    unsigned long long mid = (p00 >> 32) + (unsigned int) p01 + (unsigned int) p10;
+    *plo = (mid << 32) | (unsigned int) p00;
+    *phi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+    }
+
+// Calculate round (m * 2^e * 10^k), ties to even. Returns false if this
+// cannot be done exactly or the result does not fit in 63 bits:
+static bool scale10 (unsigned long long m, int e, int k, unsigned long long *pn)
+    {
+    unsigned long long q, r, d;
+    if (k >= 0)
+        {
+        unsigned long long hi, lo;
+        bool round, sticky;
+        if (k > FSTR_MAXP5) return false;
+        mul64x64 (m, pow5ll[k], &hi, &lo);
+        e += k;
+        if (e >= 0)
+            {
+            if ((hi != 0) || (e >= 63) || (lo > (0x7FFFFFFFFFFFFFFFULL >> e)))
+                return false;
+            *pn = lo << e;
+            return true;
+            }
+        e = -e;
+        if (e > 127) return false;
+        if (e < 64)
+            {
+            if ((hi >> e) != 0) return false;
+            q = (lo >> e) | (hi << (64 - e));
+            round = (lo >> (e - 1)) & 1;
+            sticky = (e > 1) && ((lo & ((1ULL << (e - 1)) - 1)) != 0);
+            }
+        else if (e == 64)
+            {
+            q = hi;
+            round = lo >> 63;
+            sticky = (lo << 1) != 0;
+            }
+        else
+            {
+            q = hi >> (e - 64);
+            round = (hi >> (e - 65)) & 1;
+            sticky = (lo != 0) || ((e > 65) && ((hi & ((1ULL << (e - 65)) - 1)) != 0));
+            }
+        if (q > 0x7FFFFFFFFFFFFFFFULL) return false;
+        if (round && (sticky || (q & 1))) ++q;
+        *pn = q;
+        return true;
+        }
+    k = -k;
+    if (k > FSTR_MAXP5) return false;
+    d = pow5ll[k];
+    e -= k;
+    if (e >= 0)
+        {
+        if ((e > 10) || (m > (0x7FFFFFFFFFFFFFFFULL >> e))) return false;
+        m <<= e;
+        }
+    else
+        {
+        if ((-e >= 63) || (d > (0x7FFFFFFFFFFFFFFFULL >> -e))) return false;
+        d <<= -e;
+        }
+    q = m / d;
+    r = m - q * d;
+    if ((r > d - r) || ((r == d - r) && (q & 1))) ++q;
+    *pn = q;
+    return true;
+    }
+
+// Get 'ndig' significant digits and the decimal exponent of a finite,
+// non-zero, positive double. Returns false if outside the fast range:
+static bool sigdig (unsigned long long bits, int ndig, unsigned long long *pn, int *pexp)
+    {
+    int be = (bits >> 52) & 0x7FF;
+    unsigned long long m = (bits & 0xFFFFFFFFFFFFFULL) | (1ULL << 52);
+    int dx = ((be - 1023) * 1233) >> 12; // ~ floor (log10 (2^e))
+    int iter;
+    if ((be == 0) || (ndig < 1) || (ndig > FSTR_MAXDIG)) return false;
+    for (iter = 0; iter < 3; ++iter)
+        {
+        unsigned long long n;
+        if (! scale10 (m, be - 1075, ndig - 1 - dx, &n)) return false;
+        if (n < pow10ll[ndig - 1])
+            --dx;
+        else if (n >= pow10ll[ndig])
+            ++dx;
+        else
+            {
+            *pn = n;
+            *pexp = dx;
+            return true;
+            }
+        }
+    return false;
+    }
+
+// Write decimal exponent:
+static char *expdec (char *p, int ex)
+    {
+    *p++ = 'E';
+    if (ex < 0)
+        {
+        *p++ = '-';
+        ex = -ex;
+        }
+    return p + ulltodec (ex, p);
+    }
+
+// Format a numeric value as specified by @% without using sprintf.
+// Returns the length, or -1 if the value must be formatted by sprintf:
+static int fstr (VAR v, char *dst, int format)
+    {
+    unsigned long long bits, n;
+    char dig[32];
+    char *p = dst;
+    char *q;
+    int prec = (format & 0xFF00) >> 8;
+    int nd, ex;
+
+    // General format, including &30000, prints integers exactly if they fit:
+    if (((format & 0x30000) != 0x10000) && ((format & 0x30000) != 0x20000))
+        {
+        if (prec == 0) prec = 9;
+        if (v.i.t == 0)
+            {
+            if (v.i.n < 0)
+                {
+                *p++ = '-';
+                nd = ulltodec (- (unsigned long long) v.i.n, p) + 1;
+                }
+            else
+                nd = ulltodec (v.i.n, p);
+            if (nd <= prec) return nd;
+            v.f = v.i.n;
+            p = dst;
+            }
+        }
+    else if (v.i.t == 0)
+        v.f = v.i.n;
+
+    memcpy (&bits, &v.f, sizeof (bits));
+    if (((bits >> 52) & 0x7FF) == 0x7FF) return -1; // Infinity or NaN
+    if (bits >> 63) *p++ = '-';
+    bits &= 0x7FFFFFFFFFFFFFFFULL;
+
+    switch (format & 0x30000)
+        {
+        case 0x10000:
+            // Exponent format, as "%.*E" then exponent as "%-3d":
+            if (prec) prec--;
+            if (prec >= FSTR_MAXDIG) return -1;
+            n = 0;
+            ex = 0;
+            if ((bits != 0) && (! sigdig (bits, prec + 1, &n, &ex)))
+                return -1;
+            if (bits == 0) memset (dig, '0', prec + 1);
+            else ulltodec (n, dig);
+            *p++ = dig[0];
+            if (prec)
+                {
+                *p++ = '.';
+                memcpy (p, dig + 1, prec);
+                p += prec;
+                }
+            q = p;
+            p = expdec (p, ex);
+            while (p - q < 4) *p++ = ' ';
+            break;
+
+        case 0x20000:
+            // Fixed format, as "%.*f":
+            if (prec > FSTR_MAXP5) return -1;
+            n = 0;
+            if (bits != 0)
+                {
+                int be = (bits >> 52) & 0x7FF;
+                if ((be == 0) || (! scale10 ((bits & 0xFFFFFFFFFFFFFULL) | (1ULL << 52),
+                            be - 1075, prec, &n)))
+                    return -1;
+                }
+            nd = ulltodec (n, dig);
+            if (nd <= prec)
+                {
+                // Leading zeros, including one before the decimal point
+                memmove (dig + prec + 1 - nd, dig, nd);
+                memset (dig, '0', prec + 1 - nd);
+                nd = prec + 1;
+                }
+            memcpy (p, dig, nd - prec);
+            p += nd - prec;
+            if (prec)
+                {
+                *p++ = '.';
+                memcpy (p, dig + nd - prec, prec);
+                p += prec;
+                }
+            break;
+
+        default:
+            // General format, as "%.*G" then exponent as "%d":
+            if (bits == 0)
+                {
+                *p++ = '0';
+                break;
+                }
+            if (! sigdig (bits, prec, &n, &ex))
+                return -1;
+            ulltodec (n, dig);
+            if ((ex < -4) || (ex >= prec))
+                {
+                while ((prec > 1) && (dig[prec - 1] == '0')) --prec;
+                *p++ = dig[0];
+                if (prec > 1)
+                    {
+                    *p++ = '.';
+                    memcpy (p, dig + 1, prec - 1);
+                    p += prec - 1;
+                    }
+                p = expdec (p, ex);
+                }
+            else if (ex < 0)
+                {
+                while (dig[prec - 1] == '0') --prec;
+                *p++ = '0';
+                *p++ = '.';
+                memset (p, '0', -ex - 1);
+                p += -ex - 1;
+                memcpy (p, dig, prec);
+                p += prec;
+                }
+            else
+                {
+                while ((prec > ex + 1) && (dig[prec - 1] == '0')) --prec;
+                memcpy (p, dig, ex + 1);
+                p += ex + 1;
+                if (prec > ex + 1)
+                    {
+                    *p++ = '.';
+                    memcpy (p, dig + ex + 1, prec - ex - 1);
+                    p += prec - ex - 1;
+                    }
+                }
+        }
+    *p = '\0';
+    return p - dst;
+    }
+#endif
+
 // Convert a numeric value to a NUL-terminated decimal string:
 int str (VAR v, char *dst, int format)
     {
@@ -130,6 +449,23 @@ int str (VAR v, char *dst, int format)
 	int width = format & 0xFF;
     int prec = (format & 0xFF00) >> 8;
 
+#ifdef FSTR_MAXDIG
+	char tmp[48];
+	n = fstr (v, tmp, format);
+	if (n >= 0)
+	    {
+		int pad = (n < width) ? width - n : 0;
+		if (format & 0x800000)
+		    {
+			p = strchr (tmp, '.');
+			if (p) *p = ',';
+		    }
+		memset (dst, ' ', pad);
+		memcpy (dst + pad, tmp, n + 1);
+		return n + pad;
+	    }
+#endif
+
 	switch (format & 0x30000)
 	    {
 		case 0x10000:
@@ -269,12 +605,102 @@ static unsigned long long number (int *pcount, int *ptrunc)
     return n;
     }
 
+#if defined __arm__ || defined __aarch64__ || defined __EMSCRIPTEN__
+// Exactly representable powers of ten:
+static const double xpow10x[23] = {1.0e0, 1.0e1, 1.0e2, 1.0e3, 1.0e4, 1.0e5,
+    1.0e6, 1.0e7, 1.0e8, 1.0e9, 1.0e10, 1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15,
+    1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20, 1.0e21, 1.0e22};
+
+// Fast path for a numeric constant with at most 19 significant digits.
+// Integers are accumulated in 32 bits where possible. If the digits fit
+// in 53 bits and the decimal exponent is within +/-22 the result of the
+// single multiply or divide is correctly rounded. Returns 0 (leaving esi
+// unchanged) if the constant must be parsed the slow way:
+static int fastcon (VAR *pv)
+    {
+    signed char *p = esi;
+    unsigned int w32 = 0;
+    unsigned long long w;
+    int nsig = 0, nf = 0, e = 0;
+    while ((nsig < 9) && (*p >= '0') && (*p <= '9'))
+        {
+        w32 = w32 * 10 + (*p++ - '0');
+        if (w32) nsig++;
+        }
+    w = w32;
+    while ((*p >= '0') && (*p <= '9'))
+        {
+        if (nsig >= 19) return 0;
+        w = w * 10 + (*p++ - '0');
+        if (w) nsig++;
+        }
+    if ((*p != '.') && (*p != 'E') && ((*p != 'e') || ((liston & BIT3) == 0)))
+        {
+        if (w > 0x7FFFFFFFFFFFFFFFULL) return 0;
+        pv->i.n = w;
+        pv->i.t = 0;
+        }
+    else
+        {
+        if (*p == '.')
+            {
+            p++;
+            while ((*p >= '0') && (*p <= '9'))
+                {
+                if (nsig >= 19) return 0;
+                w = w * 10 + (*p++ - '0');
+                if (w) nsig++;
+                nf++;
+                }
+            }
+        if ((*p == 'E') || ((liston & BIT3) && (*p == 'e')))
+            {
+            int neg = 0;
+            p++;
+            if (*p == '-')
+                {
+                p++;
+                neg = 1;
+                }
+            else if (*p == '+')
+                p++;
+            while ((*p >= '0') && (*p <= '9'))
+                {
+                if (e > 999) return 0;
+                e = e * 10 + (*p++ - '0');
+                }
+            if (neg) e = -e;
+            }
+        e -= nf;
+        pv->i.t = 1; // ARM
+        if (w == 0)
+            {
+            if (e + nf >= 512) return 0; // Slow path gives 'Number too big'
+            pv->f = 0.0;
+            }
+        else if ((w >= (1ULL << 53)) || (e > 22) || (e < -22))
+            return 0;
+        else if (e < 0)
+            pv->f = (double) w / xpow10x[-e];
+        else
+            pv->f = (double) w * xpow10x[e];
+        }
+    if (*p == '#') p++;
+    esi = p;
+    return 1;
+    }
+#endif
+
 // Get an unsigned numeric constant:
 VAR con (void)
     {
     VAR v;
     unsigned long long i = 0, f = 0;
     int e = 0, ni, nf = 0, ne = 0, nt = 0;
+#if defined __arm__ || defined __aarch64__ || defined __EMSCRIPTEN__
+    if (fastcon (&v))
+        return v;
+#endif
     setfpu ();
 
     i = number (&ni, &nt);
@@ -2231,20 +2657,241 @@ static VAR item_TSTRING (void)
 
 /*********************************** INSTR *************************************/
 
+#define INSTR_MINTWO 4  // Shortest needle searched with the two-way algorithm
+
+static unsigned short instr_shift[256];
+
+/*  twoway() is adapted from twoway_memmem() in musl libc (src/string/memmem.c),
+    which is distributed under the following licence:
+
+    Copyright (c) 2005-2020 Rich Felker, et al.
+
+    Permission is hereby granted, free of charge, to any person obtaining
+    a copy of this software and associated documentation files (the
+    "Software"), to deal in the Software without restriction, including
+    without limitation the rights to use, copy, modify, merge, publish,
+    distribute, sublicense, and/or sell copies of the Software, and to
+    permit persons to whom the Software is furnished to do so, subject to
+    the following conditions:
+
+    The above copyright notice and this permission notice shall be
+    included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+    IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+    CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+    TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+    SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Two-way string search (Crochemore & Perrin) combined with a Horspool
+// bad-character skip on the last byte of the window. Linear in the worst
+// case, and typically sublinear for long needles. Needle length must be
+// less than 65536:
+static const unsigned char *twoway (const unsigned char *h, size_t hl,
+    const unsigned char *n, size_t l)
+    {
+    const unsigned char *z = h + hl;
+    size_t i, ip, jp, k, p, ms, p0, mem, mem0;
+    unsigned int byteset[8] = {0};
+
+    for (i = 0; i < l; i++)
+        {
+        byteset[n[i] >> 5] |= 1u << (n[i] & 31);
+        instr_shift[n[i]] = i + 1;
+        }
+
+    // Maximal suffix for '<':
+    ip = -1; jp = 0; k = p = 1;
+    while (jp + k < l)
+        {
+        if (n[ip + k] == n[jp + k])
+            {
+            if (k == p)
+                {
+                jp += p;
+                k = 1;
+                }
+            else k++;
+            }
+        else if (n[ip + k] > n[jp + k])
+            {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+            }
+        else
+            {
+            ip = jp++;
+            k = p = 1;
+            }
+        }
+    ms = ip;
+    p0 = p;
+
+    // Maximal suffix for '>':
+    ip = -1; jp = 0; k = p = 1;
+    while (jp + k < l)
+        {
+        if (n[ip + k] == n[jp + k])
+            {
+            if (k == p)
+                {
+                jp += p;
+                k = 1;
+                }
+            else k++;
+            }
+        else if (n[ip + k] < n[jp + k])
+            {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+            }
+        else
+            {
+            ip = jp++;
+            k = p = 1;
+            }
+        }
+    if (ip + 1 > ms + 1) ms = ip;
+    else p = p0;
+
+    // Periodic needle?
+    if (memcmp (n, n + p, ms + 1))
+        {
+        mem0 = 0;
+        p = ((ms > l - ms - 1) ? ms : l - ms - 1) + 1;
+        }
+    else mem0 = l - p;
+    mem = 0;
+
+    while ((size_t)(z - h) >= l)
+        {
+        // Check the last byte of the window first:
+        unsigned char c = h[l - 1];
+        if (byteset[c >> 5] & (1u << (c & 31)))
+            {
+            k = l - instr_shift[c];
+            if (k)
+                {
+                if (k < mem) k = mem;
+                h += k;
+                mem = 0;
+                continue;
+                }
+            }
+        else
+            {
+            h += l;
+            mem = 0;
+            continue;
+            }
+
+        // Compare the right half:
+        for (k = (ms + 1 > mem) ? ms + 1 : mem; (k < l) && (n[k] == h[k]); k++);
+        if (k < l)
+            {
+            h += k - ms;
+            mem = 0;
+            continue;
+            }
+
+        // Compare the left half:
+        for (k = ms + 1; (k > mem) && (n[k - 1] == h[k - 1]); k--);
+        if (k <= mem)
+            return h;
+        h += p;
+        mem = mem0;
+        }
+    return NULL;
+    }
+
+// Find the first occurrence of needle 'n' (length l) in 'h' (length hl),
+// 0 < l <= hl:
+static const char *instr (const char *h, size_t hl, const char *n, size_t l)
+    {
+    const char *p = h;
+    const char *e = h + hl - l;
+    if ((l >= INSTR_MINTWO) && (l < 0x10000))
+        return (const char *) twoway ((const unsigned char *) h, hl,
+            (const unsigned char *) n, l);
+    while (p != NULL)
+        {
+        if (0 == memcmp (p, n, l))
+            return p;
+        p = memchr (p + 1, *n, e - p);
+        }
+    return NULL;
+    }
+
+// Test whether the remaining arguments (up to the closing bracket) can be
+// evaluated without side effects, i.e. without calling a user-defined
+// function or machine code which might modify an existing string:
+static bool nosides (signed char *p)
+    {
+    int depth = 0;
+    while (*p != 0x0D)
+        {
+        switch (*p++)
+            {
+            case '"':
+                while ((*p != '"') && (*p != 0x0D)) p++;
+                if (*p == '"') p++;
+                break;
+            case '(':
+            case TMID:          // These tokens include their opening bracket
+            case TLEFT:
+            case TRIGHT:
+            case TSTRING:
+            case TINSTR:
+            case TPOINT:
+                depth++;
+                break;
+            case ')':
+                if (depth-- == 0) return true;
+                break;
+            case TFN:
+            case TUSR:
+            case TEVAL:
+                return false;
+            }
+        }
+    return true;
+    }
+
+// Test whether a string is held in a variable (i.e. in the heap and not
+// the temporary string) so need not be copied to the stack:
+static bool instable (VAR v)
+    {
+    return (v.s.p >= lomem) && (v.s.p + v.s.l <= pfree)
+        && ((tmps.l == 0) || (v.s.p + v.s.l <= tmps.p) || (v.s.p >= tmps.p + tmps.l));
+    }
+
 static VAR item_TINSTR (void)
     {
-    heapptr *oldesp;
+    heapptr *oldesp = esp;
+    bool pure;
     int n = 0;
-    char *p;
+    const char *p;
     VAR x = exprs ();
-    oldesp = pushs (x);
-    x.s.p = (char *) esp - (char *) zero;
     comma ();
+    pure = nosides (esi);
+    if (! (pure && instable (x)))
+        {
+        pushs (x);
+        x.s.p = (char *) esp - (char *) zero;
+        }
     VAR v = exprs ();
-    pushs (v);
-    v.s.p = (char *) esp - (char *) zero;
     if (*esi == ',')
         {
+        if (! (pure && instable (v)))
+            {
+            pushs (v);
+            v.s.p = (char *) esp - (char *) zero;
+            }
         esi++;
         n = expri () - 1;
         if (n < 0)
@@ -2260,21 +2907,9 @@ static VAR item_TINSTR (void)
         return v;
         }
 
-    p = x.s.p + n + (char *) zero;
-    while (p != NULL)
-        {
-        if (0 == memcmp (p, v.s.p + zero, v.s.l))
-            {
-            v.i.t = 0;
-            v.i.n = p - (char *) zero - x.s.p + 1;
-            esp = oldesp;
-            return v;
-            }
-        p = memchr (p + 1, *(v.s.p + (char *) zero),
-            x.s.p + x.s.l - v.s.l + (char *) zero - p);
-        }
+    p = instr (x.s.p + n + (char *) zero, x.s.l - n, v.s.p + (char *) zero, v.s.l);
     v.i.t = 0;
-    v.i.n = 0;
+    v.i.n = (p == NULL) ? 0 : p - (char *) zero - x.s.p + 1;
     esp = oldesp;
     return  v;
     }
@@ -2421,7 +3056,11 @@ static VAR item_DEFAULT (void)
     esi--;
     unsigned char type;
     signed char *savesi = esi;
+#ifdef VAR_CACHE
+    void *ptr = getvar_vc (&type);
+#else
     void *ptr = getvar (&type);
+#endif
     if (ptr == NULL)
         error (16, NULL); // 'Syntax error'
     if (type == 0)
@@ -16,6 +16,12 @@
 #include <stdbool.h>
 #include <math.h>
 #include "BBC.h"
+#ifdef VAR_CACHE
+#include "varcache.h"
+#endif
+#ifdef PROFILE
+#include "profile.h"
+#endif
 
 // Routines in bbmain:
 int range1 (char);		// Test char for valid in a variable name
@@ -1234,6 +1240,112 @@ void newlin (void)
 	    }
 }
 
+#ifdef VAR_CACHE
+/******************************* Variable cache ********************************/
+
+// Each reference to a simple variable in the program is given a slot,
+// hashed on the program address of the name, holding the address and
+// type found by the last chain search. A variable does not move once
+// created, so entries remain valid until the heap is cleared or the
+// program changed. LOCAL and PRIVATE save and restore values in place.
+// The program can only be changed (NEW, LOAD, editing) in immediate mode,
+// so the cache is flushed when xeq() starts an immediate mode command.
+
+#if VAR_CACHE < 4
+#error VAR_CACHE must be the log2 of the number of cache slots, at least 4
+#endif
+#define VC_SIZE     (1 << VAR_CACHE)
+
+typedef struct
+    {
+    signed char     *site;  // Program address of variable name
+    signed char     *next;  // Program address following name
+    void            *ptr;   // Address of variable
+    unsigned short  gen;    // Generation when entry was filled
+    unsigned char   type;   // Type of variable
+    } VCENTRY;
+
+static VCENTRY vcache[VC_SIZE];
+static unsigned short vcgen = 1;
+static heapptr vcfree = 0;
+VCSTATS vcstats;
+bool bVarCache = true;
+
+// Invalidate all entries:
+void varcache_flush (void)
+    {
+    if (++vcgen == 0)
+        {
+        memset (vcache, 0, sizeof (vcache));
+        vcgen = 1;
+        }
+    vcfree = pfree;
+    ++vcstats.flushes;
+    }
+
+// Test for a plain variable name, without subscripts, members or indirection:
+static bool vc_simple (signed char *p, signed char *q)
+    {
+    if (p == q)
+        return false;
+    while ((p < q) && (*p != '.') && range1 (*p))
+        ++p;
+    if ((p < q) && ((*p == '%') || (*p == '&') || (*p == '$') || (*p == '#')))
+        {
+        ++p;
+        if ((p < q) && (*p == '%') && (*(p-1) == '%'))
+            ++p;
+        }
+    return (p == q);
+    }
+
+static void *vc_lookup (void *(*search)(unsigned char *), unsigned char *ptype)
+    {
+    signed char *site = esi;
+    VCENTRY *pvc;
+    void *ptr;
+    if ((! bVarCache) || (site < vpage + (signed char *) zero)
+        || (site >= lomem + (signed char *) zero))
+        return search (ptype);
+    if (pfree < vcfree)
+        varcache_flush (); // Heap has been cleared
+    pvc = &vcache[((size_t) site ^ ((size_t) site >> VAR_CACHE)) & (VC_SIZE - 1)];
+    if ((pvc->site == site) && (pvc->gen == vcgen))
+        {
+        ++vcstats.hits;
+        esi = pvc->next;
+        *ptype = pvc->type;
+        return pvc->ptr;
+        }
+    ++vcstats.misses;
+    ptr = search (ptype);
+    if ((ptr != NULL) && (*ptype != 0) && ((*ptype & (BIT4 | BIT6)) == 0)
+        && vc_simple (site, esi))
+        {
+        pvc->site = site;
+        pvc->next = esi;
+        pvc->ptr = ptr;
+        pvc->type = *ptype;
+        pvc->gen = vcgen;
+        vcfree = pfree;
+        ++vcstats.fills;
+        }
+    return ptr;
+    }
+
+// Get a variable's pointer and type, using the cache if possible:
+void *getvar_vc (unsigned char *ptype)
+    {
+    return vc_lookup (getvar, ptype);
+    }
+
+// Get, and if necessary create, a variable, using the cache if possible:
+void *getput_vc (unsigned char *ptype)
+    {
+    return vc_lookup (getput, ptype);
+    }
+#endif
+
 static signed char al_token;
 static void *tmpesi;
 static bool bFlgChk;
@@ -1886,6 +1998,9 @@ static void xeq_TPAGEL (void)
     if ((n + STACK_NEEDED) > (void *) esp)
         error (8, NULL); // 'Address out of range'
     vpage = n - zero;
+#ifdef VAR_CACHE
+    varcache_flush ();
+#endif
     }
 
 /************************************ LOMEM ************************************/
@@ -1899,6 +2014,9 @@ static void xeq_TLOMEML (void)
     clear ();
     lomem = n - zero;
     pfree = n - zero;
+#ifdef VAR_CACHE
+    varcache_flush ();
+#endif
     }
 
 /************************************ HIMEM ************************************/
@@ -1937,6 +2055,9 @@ static void xeq_TRUN (void)
         }
     clrtrp ();
     clear ();
+#ifdef VAR_CACHE
+    varcache_flush ();
+#endif
     datptr = search (vpage + (signed char *) zero, TDATA) -	
         (signed char *) zero;
     esi = vpage + (signed char *) zero;
@@ -1954,6 +2075,9 @@ static void xeq_TCHAIN (void)
         (signed char *)esp - (signed char *)zero - vpage - STACK_NEEDED);
     clrtrp ();
     clear ();
+#ifdef VAR_CACHE
+    varcache_flush ();
+#endif
     datptr = search (vpage + (signed char *) zero, TDATA) -	
         (signed char *) zero;
     esi = vpage + (signed char *) zero;
@@ -2283,6 +2407,9 @@ static void xeq_TERROR (void)
 static void xeq_TCLEAR (void)
     {
     clear ();
+#ifdef VAR_CACHE
+    varcache_flush ();
+#endif
     datptr = search (vpage + (signed char *) zero, TDATA) -
         (signed char *) zero;
     }
@@ -3935,7 +4062,11 @@ static void xeq_TLET (void)
     void *ptr, *ebp;
     unsigned char type;
 
+#ifdef VAR_CACHE
+    ptr = getput_vc (&type);
+#else
     ptr = getput (&type);
+#endif
     if ((type & (BIT4 | BIT6)) == 0) // scalar
         {
         if (type < 128)
@@ -4293,6 +4424,10 @@ static const xeq_func xeq_list[] =
 VAR xeq (void)
     {
     bFlgChk = true;
+#ifdef VAR_CACHE
+    if ((esi < vpage + (signed char *) zero) || (esi >= lomem + (signed char *) zero))
+        varcache_flush (); // Immediate mode, program may have changed
+#endif
 	while (1) // for each statement
 	    {
 #if PICO_STACK_CHECK & 0x01
@@ -4314,6 +4449,9 @@ VAR xeq (void)
 		al_token = nxt ();
 		tmpesi = esi;
 		curlin = esi - (signed char *) zero;
+#ifdef PROFILE
+		if (bProfile) profile_stmt (esi);
+#endif
 		while (*++esi == ' ');
 
         if ( al_token == '=' ) return xeq_ENDFN ();
@@ -27,6 +27,7 @@
 #include <time.h>
 #include <math.h>
 #include "bbccon.h"
+#include "spscq.h"
 
 #ifndef TOP_OF_STACK_1
 extern char __StackTop;
@@ -136,7 +137,23 @@ static inline void ISTORE(void* p, int i){ if ((intptr_t)p&3) *((unaligned_int*)
 
 #define ESCTIME 200  // Milliseconds to wait for escape sequence
 #define QRYTIME 1000 // Milliseconds to wait for cursor query response
-#define QSIZE 32     // Twice longest expected escape sequence
+#define KBDTIME 500  // Milliseconds without keyboard reads before input is no longer held
+#ifndef KBDQ_SIZE
+#define KBDQ_SIZE 256   // Keyboard queue (must be a power of 2)
+#endif
+#ifndef INPQ_SIZE
+#define INPQ_SIZE 512   // STDIN queue, enough for a burst of pasted text (must be a power of 2)
+#endif
+#ifndef EVTQ_SIZE
+#define EVTQ_SIZE 64    // Event queue (must be a power of 2)
+#endif
+#ifndef CON_XONXOFF     // Send XOFF / XON as the STDIN queue fills and empties
+#if defined(STDIO_UART) && ! defined(STDIO_USB)
+#define CON_XONXOFF 1
+#else
+#define CON_XONXOFF 0
+#endif
+#endif
 
 #ifdef _WIN32
 #define HISTORY 100  // Number of items in command history
@@ -158,10 +175,14 @@ BOOL WINAPI K32EnumProcessModules (HANDLE, HMODULE*, DWORD, LPDWORD);
 #include <hardware/flash.h>
 #include <hardware/exception.h>
 #include <hardware/watchdog.h>
+#include <hardware/sync.h>
 #include <pico/bootrom.h>
 #include <pico/stdlib.h>
 #include <pico/time.h>
 #include <pico/binary_info.h>
+#ifdef VDU_CORE1
+#include <pico/mutex.h>
+#endif
 #if PICO_STACK_CHECK & 0x04
 #if PICO == 1
 #include <hardware/structs/mpu.h>
@@ -175,6 +196,7 @@ BOOL WINAPI K32EnumProcessModules (HANDLE, HMODULE*, DWORD, LPDWORD);
 #ifdef STDIO_BT
 #include <stdio_bt.h>
 #endif
+#include "gpioevt.h"
 #define WM_TIMER 275
 #include "lfswrap.h"
 extern char __StackLimit;
@@ -407,8 +429,13 @@ static const int vdulen[] = {
     0,   1,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
     0,   1,   2,   5,   0,   0,   1,   9,   8,   5,   0,   1,   4,   4,   0,   2 };
 
+// Buffered console output:
+void conflush (void);
+int conputc (int c);
+int conprintf (const char *psFmt, ...);
+
 #if ( defined(STDIO_USB) || defined(STDIO_UART) || defined(STDIO_BT) )
-#define printf(...) fprintf (stdout, __VA_ARGS__)
+#define printf(...) conprintf (__VA_ARGS__)
 extern bool bBBCtl;
 #endif
 
@@ -468,6 +495,10 @@ int copyread (void);
 void copymove (uint8_t key);
 void copyedit (bool bEnable);
 #endif
+#ifdef VDU_CORE1
+void vdustart (void);
+void vdupaged (void);
+#endif
 
 #ifdef PICO_SOUND
 void bell (void);
@@ -490,6 +521,7 @@ unsigned char osbget (void*, int*);
 int oskey (int wait);
 void osbput (void*, unsigned char);
 void quiet (void);
+unsigned int GetTicks (void);
 
 // Dummy functions:
 void gfxPrimitivesSetFont(void) { };
@@ -497,42 +529,75 @@ void gfxPrimitivesGetFont(void) { };
 void RedefineChar(void) { };
 
 // File scope variables:
+typedef struct
+    {
+	int lparam;
+	int msg;
+	int wparam;
+	heapptr handler;
+    } EVTITEM;
+
+static unsigned char kbdbuf[KBDQ_SIZE];
+static SPSCQ kbdq = SPSCQ_INIT (kbdbuf, KBDQ_SIZE, 1);
+static EVTITEM evtbuf[EVTQ_SIZE];
+static SPSCQ evtq = SPSCQ_INIT (evtbuf, EVTQ_SIZE, sizeof (EVTITEM));
+
 #if KBD_STDIN
-static unsigned char inputq[QSIZE];
-static volatile int inpqr = 0, inpqw = 0;
+static unsigned char inpbuf[INPQ_SIZE];
+static SPSCQ inpq = SPSCQ_INIT (inpbuf, INPQ_SIZE, 1);
+static unsigned int tkbdrd = 0;         // Time keyboard queue last read
 
-// Put to STDIN queue:
+#ifndef PICO
+// Put to STDIN queue. The reader thread retries, so a full queue is not a drop:
 static int putinp (unsigned char inp)
     {
-	unsigned char bl = inpqw;
-	unsigned char al = (bl + 1) % QSIZE;
-#ifdef STDIO_UART
-	static unsigned char bFirst = 1;
-	if ( bFirst )
-	    {
-	    bFirst = 0;
-        return 0;
-	    }
-#endif
-	if (al != inpqr)
-	    {
-		inputq[bl] = inp;
-		inpqw = al;
-		return 1;
-	    }
-	return 0;
+	if (spscq_free (&inpq) == 0)
+		return 0;
+	return spscq_put (&inpq, &inp);
     }
+#endif
 
 #ifdef PICO
+#if CON_XONXOFF
+static bool bXoff = false;
+#endif
+
+// Move everything the stdio drivers have received into the STDIN queue.
+// Input is left with the driver if the queue is full:
 inline static void myPoll(){
-    static int c = PICO_ERROR_TIMEOUT;
-    for(;;){
-        if ((c != PICO_ERROR_TIMEOUT) && (putinp(c) == 0))
+    uint32_t n;
+    char *p;
+#ifdef STDIO_UART
+    static unsigned char bFirst = 1;
+    if ( bFirst )
+        {
+        int c = getchar_timeout_us (0);
+        if ( c == PICO_ERROR_TIMEOUT ) return;
+        unsigned char inp = c;
+        spscq_put (&inpq, &inp);
+        bFirst = 0;
+        }
+#endif
+    while ((p = spscq_wrptr (&inpq, &n)) != NULL){
+#if PICO_SDK_VERSION_MAJOR >= 2
+        int nread = stdio_get_until (p, n, get_absolute_time ());
+        if (nread <= 0)
             break;
-        c=getchar_timeout_us(0);
+        spscq_wrdone (&inpq, nread);
+#else
+        int c = getchar_timeout_us (0);
         if (c == PICO_ERROR_TIMEOUT)
             break;
+        *p = c;
+        spscq_wrdone (&inpq, 1);
+#endif
+        }
+#if CON_XONXOFF
+    if (!bXoff && !bBBCtl && (spscq_free (&inpq) < INPQ_SIZE / 4)){
+        putchar_raw (0x13);
+        bXoff = true;
         }
+#endif
     }
 #endif
 
@@ -542,17 +607,29 @@ static int getinp (unsigned char *pinp)
 #ifdef PICO
 	myPoll();
 #endif
-	unsigned char bl = inpqr;
-	if (bl != inpqw)
+#if defined(PICO) && CON_XONXOFF
+	if (bXoff && (spscq_free (&inpq) > INPQ_SIZE / 2))
 	    {
-		*pinp = inputq[bl];
-		inpqr = (bl + 1) % QSIZE;
-		return 1;
+		putchar_raw (0x11);
+		bXoff = false;
 	    }
-	return 0;
+#endif
+	return spscq_get (&inpq, pinp);
     }
 #endif  // KBD_STDIN
 
+// Number of items dropped from each input queue because it was full:
+void queue_drops (unsigned int *pnkbd, unsigned int *pninp, unsigned int *pnevt)
+    {
+	*pnkbd = kbdq.ndrop;
+#if KBD_STDIN
+	*pninp = inpq.ndrop;
+#else
+	*pninp = 0;
+#endif
+	*pnevt = evtq.ndrop;
+    }
+
 #ifdef _WIN32
 #define RTLD_DEFAULT (void *)(-1)
 static void *dlsym (void *handle, const char *symbol)
@@ -633,59 +710,45 @@ static void *mymap (unsigned int size)
     }
 #endif
 
-// Put event into event queue, unless full:
+// Put event into event queue, unless full. Events come from both timer
+// callbacks and the interpreter, so the producer side is serialised:
 int putevt (heapptr handler, int msg, int wparam, int lparam)
     {
-	unsigned char bl = evtqw;
-	unsigned char al = bl + 8;
-	int index = bl >> 2;
-	if ((al == evtqr) || (eventq == NULL))
-		return 0;
-	eventq[index] = lparam;
-	eventq[index + 1] = msg;
-	eventq[index + 64] = wparam;
-	eventq[index + 65] = handler;
-	evtqw = al;
-	return 1;
+	EVTITEM evt = { lparam, msg, wparam, handler };
+#ifdef PICO
+	uint32_t save = save_and_disable_interrupts ();
+	int iRes = spscq_put (&evtq, &evt);
+	restore_interrupts (save);
+	return iRes;
+#else
+	return spscq_put (&evtq, &evt);
+#endif
     }
 
 // Get event from event queue, unless empty:
 static heapptr getevt (void)
     {
-	heapptr handler;
-	unsigned char al = evtqr;
-	int index = al >> 2;
+	EVTITEM evt;
 	flags &= ~ALERT;
-	if ((al == evtqw) || (eventq == NULL))
+	if (! spscq_get (&evtq, &evt))
 		return 0;
-	lParam = eventq[index];
-	iMsg = eventq[index + 1];
-	wParam = eventq[index + 64];
-	handler = eventq[index + 65];
-	al += 8;
-	evtqr = al;
-	if (al != evtqw)
+	lParam = evt.lparam;
+	iMsg = evt.msg;
+	wParam = evt.wparam;
+	if (spscq_count (&evtq))
 		flags |= ALERT;
-	return handler;
+	return evt.handler;
     }
 
 // Put keycode to keyboard queue:
 int putkey (char key)
     {
-	unsigned char bl = kbdqw;
-	unsigned char al = bl + 1;
 	if ((key == 0x1B) && !(flags & ESCDIS))
 	    {
 		flags |= ESCFLG;
 		return 0;
 	    }
-	if (al != kbdqr)
-	    {
-		keybdq[(int) bl] = key;
-		kbdqw = al;
-		return 1;
-	    }
-	return 0;
+	return spscq_put (&kbdq, &key);
     }
 
 // Get keycode (if any) from keyboard queue:
@@ -694,22 +757,20 @@ int getkey (unsigned char *pkey)
 #if defined (PICO) && KBD_STDIN
 	myPoll();
 #endif
-	unsigned char bl = kbdqr;
-	if (bl != kbdqw)
-	    {
-		*pkey = keybdq[(int) bl];
-		kbdqr = bl + 1;
-		return 1;
-	    }
-	return 0;
+	if (!spscq_get (&kbdq, pkey))
+		return 0;
+#if KBD_STDIN
+	tkbdrd = GetTicks ();
+#endif
+	return 1;
     }
 
 #if KBD_STDIN
 // Get a character from any input queue
 int anykey (unsigned char *pkey, int tmo)
     {
-    if ( kbdqr != kbdqw ) return getkey (pkey);
-    if ( inpqr != inpqw ) return getinp (pkey);
+    if ( spscq_count (&kbdq) ) return getkey (pkey);
+    if ( spscq_count (&inpq) ) return getinp (pkey);
     int c = getchar_timeout_us (tmo);
     if ( c == PICO_ERROR_TIMEOUT ) return 0;
     *pkey = c;
@@ -741,7 +802,7 @@ static int kbchk (void)
 #ifdef PICO
 	myPoll();
 #endif
-	return (inpqr != inpqw);
+	return (spscq_count (&inpq) != 0);
     }
 
 static unsigned char kbget (void)
@@ -761,6 +822,37 @@ static int kwait (unsigned int timeout)
     }
 #endif  // KBD_STDIN
 
+#if KBD_STDIN
+// Test whether to leave console input queued because the keyboard queue is full.
+// Input is only held while the program is reading the keyboard, and an Escape
+// in the held input is acted on at once, discarding the input before it:
+static int inphold (void)
+    {
+	unsigned char ch;
+	uint32_t n = 0;
+	if (spscq_free (&kbdq) > 16)
+		return 0;
+	if ((unsigned int)(GetTicks () - tkbdrd) >= KBDTIME)
+		return 0;
+	if (flags & ESCDIS)
+		return 1;
+	while (spscq_peekn (&inpq, n, &ch))
+	    {
+		++n;
+		if (ch == 0x1B)
+		    {
+			// Not the start of a cursor key sequence
+			if (spscq_peekn (&inpq, n, &ch) && ((ch == '[') || (ch == 'O')))
+				continue;
+			spscq_skip (&inpq, n);
+			putkey (0x1B);
+			break;
+		    }
+	    }
+	return 1;
+    }
+#endif
+
 // Returns 1 if the cursor position was read successfully or 0 if it was aborted
 // (in which case *px and *py will be unchanged) or if px and py are both NULL.
 int stdin_handler (int *px, int *py)
@@ -775,19 +867,20 @@ int stdin_handler (int *px, int *py)
     if ( bBBCtl && wait )
         {
         printf ("\x17\x1F\x00");
-		fflush (stdout);
+		conflush ();
         }
     else
 #endif
 	if (wait)
 	    {
 		printf ("\033[6n");
-		fflush (stdout);
+		conflush ();
 	    }
 
 	do
 	    {
-		if (kbchk ())
+		// Unless waiting for a reply, leave input queued while the keyboard queue is full
+		if ((wait || (p != report) || !inphold ()) && kbchk ())
 		    {
 			ch = kbget ();
 				
@@ -830,7 +923,7 @@ int stdin_handler (int *px, int *py)
 			else
 			    {
 				putkey (ch);
-				if (((kbdqr - kbdqw - 1) & 0xFF) < 50)
+				if (spscq_free (&kbdq) < 50)
 				    {
 					p = report;
 					q = report;
@@ -978,7 +1071,7 @@ static bool init_adc = false;
 int adval (int n)
     {
 	if (n == -1)
-        return (kbdqr - kbdqw - 1) & 0xFF;
+        return spscq_free (&kbdq);
 #ifdef PICO_SOUND
     if ((n >= -8) && (n <= -5)) return snd_free (-5 - n);
 #endif
@@ -1079,9 +1172,134 @@ size_t guicall (void *func, PARM *parm)
 	return apicall_ (func, parm);
     }
 
+// Console output is collected in one buffer, so that printf and single characters
+// stay in order. It is flushed at the end of a line, before waiting for input, when
+// it fills, and (through trap) shortly after output stops:
+#ifndef CON_BUF
+#define CON_BUF     256
+#endif
+#ifndef CON_IDLE_MS
+#define CON_IDLE_MS 20
+#endif
+static char conbuf[CON_BUF];            // Console output not yet flushed
+static int ncon = 0;                    // Number of bytes in conbuf
+#ifdef VDU_CORE1
+auto_init_mutex (conmtx);               // Core 1 also writes (VDU 2 printer)
+#endif
+#ifdef PICO
+static volatile bool bConAlarm = false; // Idle flush requested
+
+static int64_t conidle (alarm_id_t id, void *user_data)
+    {
+    bConAlarm = false;
+    flags |= ALERT;
+    return 0;
+    }
+#endif
+
+static void conlock (void)
+    {
+#ifdef VDU_CORE1
+    mutex_enter_blocking (&conmtx);
+#endif
+    }
+
+static void conunlock (void)
+    {
+#ifdef VDU_CORE1
+    mutex_exit (&conmtx);
+#endif
+    }
+
+// Write out the buffer. The caller holds the lock:
+static void condrain (void)
+    {
+    if ( ncon == 0 ) return;
+#if defined(PICO) && ( PICO_SDK_VERSION_MAJOR >= 2 )
+    stdio_put_string (conbuf, ncon, false, true);
+    stdio_flush ();
+#else
+    fwrite (conbuf, 1, ncon, stdout);
+    fflush (stdout);
+#endif
+    ncon = 0;
+    }
+
+// Append to the buffer. The caller holds the lock:
+static void conadd (const char *ps, int n)
+    {
+    while ( n > 0 )
+        {
+        int nc = CON_BUF - ncon;
+        if ( nc > n ) nc = n;
+        memcpy (conbuf + ncon, ps, nc);
+        ncon += nc;
+        ps += nc;
+        n -= nc;
+        if ( ncon == CON_BUF ) condrain ();
+        }
+#ifdef PICO
+    if (( ncon > 0 ) && ( ! bConAlarm ))
+        {
+        bConAlarm = true;
+        if ( add_alarm_in_ms (CON_IDLE_MS, conidle, NULL, true) < 0 ) bConAlarm = false;
+        }
+#endif
+    }
+
+void conflush (void)
+    {
+    conlock ();
+    condrain ();
+    conunlock ();
+    }
+
+int conputc (int c)
+    {
+    char ch = c;
+    conlock ();
+    conadd (&ch, 1);
+    conunlock ();
+    return (unsigned char) c;
+    }
+
+int conprintf (const char *psFmt, ...)
+    {
+    char *ps;
+    va_list va;
+    va_start (va, psFmt);
+    conlock ();
+    int n = vsnprintf (conbuf + ncon, CON_BUF - ncon, psFmt, va);
+    va_end (va);
+    if ( n < CON_BUF - ncon )
+        {
+        ncon += n;
+        conadd (NULL, 0);   // Arm the idle flush
+        }
+    else if ( n < CON_BUF )
+        {
+        condrain ();
+        va_start (va, psFmt);
+        ncon = vsnprintf (conbuf, CON_BUF, psFmt, va);
+        va_end (va);
+        conadd (NULL, 0);
+        }
+    else if ( (ps = malloc (n + 1)) != NULL )
+        {
+        va_start (va, psFmt);
+        vsnprintf (ps, n + 1, psFmt, va);
+        va_end (va);
+        conadd (ps, n);
+        free (ps);
+        }
+    conunlock ();
+    return n;
+    }
+
 // Check for Escape (if enabled) and kill:
 void trap (void)
     {
+	conflush ();
 #if KBD_STDIN
 	stdin_handler (NULL, NULL);
 #endif
@@ -1091,7 +1309,7 @@ void trap (void)
 	if (flags & ESCFLG)
 	    {
 		flags &= ~ESCFLG;
-		kbdqr = kbdqw;
+		spscq_flush (&kbdq);
 		quiet ();
 		if (exchan)
 		    {
@@ -1114,13 +1332,21 @@ heapptr xtrap (void)
     {
 	trap ();
 	if (flags & ALERT)
+	    {
+#ifdef PICO
+		gpio_event_post ();
+#endif
 		return getevt ();
+	    }
 	return 0;
     }
 
 // Read keyboard or F-key expansion:
 static int rdkey (unsigned char *pkey)
     {
+#ifdef VDU_CORE1
+	vdupaged ();
+#endif
 	if (keyptr)
 	    {
 		*pkey = *keyptr++;
@@ -1200,6 +1426,7 @@ unsigned char osrdch (void)
 	if (optval >> 4)
 		return osbget ((void *)(size_t)(optval >> 4), NULL);
 
+	conflush ();
 	while (!rdkey (&key))
         {
 		usleep (5000);
@@ -1231,7 +1458,8 @@ void oswrch (unsigned char vdu)
 #if ( defined(STDIO_USB) || defined(STDIO_UART) || defined(STDIO_BT) )
     if ( bBBCtl )
         {
-        putchar (vdu);
+        conputc (vdu);
+        if ( vdu == 10 ) conflush ();
         return;
         }
 #endif
@@ -1251,7 +1479,6 @@ void oswrch (unsigned char vdu)
 			pqueue -= ecx - 9;
             for (; ecx > 0; ecx--)
                 xeqvdu (*pqueue++ << 8, 0, 0);
-			fflush (stdout);
 			return;
 		    }
 	    }
@@ -1266,7 +1493,6 @@ void oswrch (unsigned char vdu)
 			return;
 		    }
 		xeqvdu (vdu << 8, 0, 0);
-		fflush (stdout);
 		return;
 	    }
 	else
@@ -1294,6 +1520,8 @@ void oswrch (unsigned char vdu)
 //  vduq->  n  v
 
 	xeqvdu (*(int*)(pqueue + 8) & 0xFFFF, *(int*)(pqueue + 4), *(int*)pqueue);
+	if (vduq[9] == 10)
+		conflush ();
     }
 
 // Prepare for outputting an error message:
@@ -1305,6 +1533,32 @@ void reset (void)
 	reflag = 0;	// *REFRESH ON
     }
 
+// Read printable characters which are already waiting, such as pasted text,
+// without the per-key work of the line editor:
+static int rdburst (char *p, int nmax)
+    {
+	unsigned char key;
+	int n = 0;
+	if (keyptr || exchan || (optval >> 4))
+		return 0;
+	while (n < nmax)
+	    {
+		if (!spscq_peek (&kbdq, &key))
+		    {
+#if KBD_STDIN
+			stdin_handler (NULL, NULL);
+			if (!spscq_peek (&kbdq, &key))
+#endif
+				break;
+		    }
+		if ((key < 0x20) || (key >= 0x7F))
+			break;
+		spscq_get (&kbdq, &key);
+		p[n++] = key;
+	    }
+	return n;
+    }
+
 // Input and edit a string :
 void osline (char *buffer)
     {
@@ -1535,6 +1789,19 @@ void osline (char *buffer)
 								(*(signed char*)q < -64));
 							memmove (p, q, buffer + 256 - q);
 						    }
+						else if ((*p == 0x0D) && (key < 0x7F)
+#if defined(PICO_GUI) || defined(PICO_GRAPH)
+							&& !bCopyEdit
+#endif
+							)
+						    {
+							// Typing at the end of the line: take any burst in one go
+							n = rdburst (p, buffer + 255 - p);
+							for (int i = 0; i < n; i++)
+								oswrch (p[i]);
+							p += n;
+							*p = 0x0D;
+						    }
 					    }
 				    }
 		    }
@@ -2297,8 +2564,8 @@ void allocbuf (void)
 	buff = (char*) memptr; memptr += 0x100;		    // Temporary string buffer
 	path = (char*) memptr; memptr += 0x100;		    // File path
 	keystr = (char**) memptr; memptr += 0x100;	    // *KEY strings
-	keybdq = (char*) memptr; memptr += 0x100;	    // Keyboard queue
-	eventq = (int*) memptr; memptr += 0x200;	    // Event queue
+	keybdq = (char*) memptr; memptr += 0x100;	    // Keyboard queue (unused, see kbdq)
+	eventq = (int*) memptr; memptr += 0x200;	    // Event queue (unused, see evtq)
 	filbuf[0] = (int*) memptr; memptr += 0x100 * MAX_FILES;	// File buffers
 #if PICO_SOUND == 3
 	envels = (signed char*) memptr; memptr += 0x100;	// Envelopes
@@ -2708,6 +2975,7 @@ void main_term (int exitcode)
 	printf ("\nExiting with code %d...rebooting...\n",
 		exitcode);
 #endif
+	conflush ();
 	watchdog_reboot(0,0,50);
     for(;;) sleep(5);
 # else
@@ -2823,6 +3091,9 @@ void *main_init (int argc, char *argv[])
 #if defined(PICO_GUI) || defined(PICO_GRAPH)
     dma_channel_unclaim (0);  // Free DMA channel for video
     setup_vdu ();
+#ifdef VDU_CORE1
+    vdustart ();
+#endif
 #endif
 #ifdef PICO_GUI
     setup_keyboard ();
@@ -47,20 +47,7 @@ extern void *libase;
 extern void *libtop;
 #endif
 #if SOFT_CSR
-static uint32_t nFlash = 0;         // Time counter for cursor flash
 critical_section_t cs_csr;          // Critical section controlling cursor flash
-
-static PRD_FUNC pnext = NULL;
-
-static void video_periodic (void)
-    {
-    if ( ++nFlash >= 5 )
-        {
-        flashcsr ();
-        nFlash = 0;
-        }
-    if (pnext) pnext ();
-    }
 #endif
 
 void setup_fbuf (void)
@@ -72,7 +59,11 @@ void setup_fbuf (void)
     memset (shadowbuf, 0, BUF_SIZE);
 #if SOFT_CSR    
     critical_section_init (&cs_csr);
-    pnext = add_periodic (video_periodic);
+#ifdef VDU_CORE1
+    add_periodic (vduflashcsr, 500, 2);
+#else
+    add_periodic (flashcsr, 500, 2);
+#endif
 #endif
     }
 
@@ -14,12 +14,14 @@
 
 */
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include "bbccon.h"
 #include "framebuf.h"
+#include "scrnrle.h"
 
 #ifdef VDU_OUT
 void VDU_OUT (uint8_t *fbuf, int xp1, int yp1, int xp2, int yp2);
@@ -42,6 +44,9 @@ void VDU_SCROLL (uint8_t *fbuf, int lt, int lb, bool bUp);
 #ifdef VDU_SCROLL7
 void VDU_SCROLL7 (uint8_t *fbuf, int lt, int lb, bool bUp);
 #endif
+#ifdef VDU_ROLL
+void VDU_ROLL (int yorg);
+#endif
 
 #if REF_MODE == 3
 RFM rfm = rfmNone;
@@ -52,6 +57,30 @@ static const MODE *pmode = NULL;
 static CLRDEF *cdef = NULL;                 // Colour definitions
 static bool bCsrVis = false;
 static int nCsrHide = 0;
+#ifdef VDU_ROLL
+static int yorg = 0;                        // Framebuffer row displayed at top of screen
+#endif
+
+#ifndef GLYPH_CACHE
+#define GLYPH_CACHE 6                       // Log2 of number of cached glyphs (0 = no cache)
+#endif
+
+#if GLYPH_CACHE > 0
+/*  Cache of character glyphs already expanded to pixels for the current mode and text
+    colours, so that printing a repeated character is just a copy of eight words.
+    Entries are keyed on the address of the glyph definition and the text colours.
+    The whole cache is discarded on a mode change or character redefinition (VDU 23).
+*/
+typedef struct
+    {
+    const uint8_t   *pch;                   // Glyph definition (NULL for unused entry)
+    uint8_t         fg;                     // Text foreground colour
+    uint8_t         bg;                     // Text background colour
+    uint32_t        pix[8];                 // Expanded pixel rows
+    } GLYPH;
+
+static GLYPH glyphs[1 << GLYPH_CACHE];
+#endif
 
 static const uint32_t cpx02[] = { 0x00000000, 0xFFFFFFFF };
 static const uint32_t cpx04[] = { 0x00000000, 0x55555555, 0xAAAAAAAA, 0xFFFFFFFF };
@@ -166,11 +195,112 @@ static const uint32_t bkwmsk[] = {
     0x0001FFFF, 0x0003FFFF, 0x0007FFFF, 0x000FFFFF, 0x001FFFFF, 0x003FFFFF, 0x007FFFFF, 0x00FFFFFF,
     0x01FFFFFF, 0x03FFFFFF, 0x07FFFFFF, 0x0FFFFFFF, 0x1FFFFFFF, 0x3FFFFFFF, 0x7FFFFFFF, 0xFFFFFFFF };
 
+#ifdef VDU_OUT
+static bool bSpans = false;                 // Merging updates for consecutive spans
+static int xs1, ys1, xs2, ys2;              // Pending update for merged spans
+
+static void spanout (void)
+    {
+    if ( ys2 > ys1 )
+        {
+        VDU_OUT (framebuf, xs1, ys1, xs2, ys2);
+        ys2 = ys1;
+        }
+    }
+
+#define NDIRTY  8
+typedef struct
+    {
+    short   x1, y1, x2, y2;                 // Pixel bounds (exclusive at right and bottom)
+    } RECT;
+static RECT dirty[NDIRTY];                  // Pending updates for sprites
+static int ndirty = 0;
+
+// Output the regions changed by sprites:
+static void dirtyout (void)
+    {
+    for (int i = 0; i < ndirty; ++i)
+        {
+        VDU_OUT (framebuf, dirty[i].x1, dirty[i].y1, dirty[i].x2, dirty[i].y2);
+        }
+    ndirty = 0;
+    }
+
+// Add a region changed by a sprite, merging it with any pending region it touches:
+static void dirtyadd (int x1, int y1, int x2, int y2)
+    {
+    int i = 0;
+    while ( i < ndirty )
+        {
+        RECT *pr = &dirty[i];
+        if (( ndirty == NDIRTY ) || (( x1 <= pr->x2 ) && ( x2 >= pr->x1 )
+                && ( y1 <= pr->y2 ) && ( y2 >= pr->y1 )))
+            {
+            if ( pr->x1 < x1 ) x1 = pr->x1;
+            if ( pr->y1 < y1 ) y1 = pr->y1;
+            if ( pr->x2 > x2 ) x2 = pr->x2;
+            if ( pr->y2 > y2 ) y2 = pr->y2;
+            *pr = dirty[--ndirty];
+            i = 0;
+            }
+        else
+            {
+            ++i;
+            }
+        }
+    dirty[ndirty].x1 = x1;
+    dirty[ndirty].y1 = y1;
+    dirty[ndirty].x2 = x2;
+    dirty[ndirty].y2 = y2;
+    ++ndirty;
+    }
+#endif
+
+static void sprfree (void);
+
 void fbmode (uint8_t *fb, MODE *pm)
     {
+    sprfree ();
+#ifdef VDU_OUT
+    spanout ();
+    dirtyout ();
+#endif
     framebuf = fb;
     pmode = pm;
     cdef = &clrdef[pmode->ncbt];
+#ifdef VDU_ROLL
+    yorg = 0;
+    VDU_ROLL (yorg);
+#endif
+    newglyph ();
+    }
+
+/*  When the display driver supports it (VDU_ROLL), the framebuffer is circular.
+    Pixel row yp of the screen is held in framebuffer row (yp + yorg) modulo the
+    number of rows, and scrolling the whole screen just moves the origin by one
+    text row. The origin is always a whole number of text rows, so each text row
+    is contiguous in the framebuffer.
+*/
+
+// Address of the start of pixel row yp:
+static inline uint8_t *fbrow (int yp)
+    {
+#ifdef VDU_ROLL
+    yp += yorg;
+    if ( yp >= pmode->grow ) yp -= pmode->grow;
+#endif
+    return framebuf + yp * pmode->nbpl;
+    }
+
+// Test whether a scroll of the text viewport can be done by moving the origin:
+static inline bool fbroll (void)
+    {
+#ifdef VDU_ROLL
+    return ( tvt == 0 ) && ( tvb == pmode->trow - 1 ) && ( reflag != 1 )
+        && ( pmode->trow * pmode->thgt == pmode->grow );
+#else
+    return false;
+#endif
     }
 
 #if SOFT_CSR
@@ -179,7 +309,7 @@ static void flipcsr (int xp, int yp, int ya, int yb)
     yp += ya;
     int xpc = xp;
     int ypc = yp;
-    uint32_t *fb = (uint32_t *)(framebuf + yp * pmode->nbpl);
+    uint32_t *fb = (uint32_t *) fbrow (yp);
     xp <<= cdef->bitsh;
     fb += xp >> 5;
     xp &= 0x1F;
@@ -304,10 +434,21 @@ void scrldn (void)
     else if (( tvl == 0 ) && ( tvr == pmode->tcol - 1 ))
         {
         uint8_t bgfill = (uint8_t) cdef->cpx[txtbak];
-        memmove (framebuf + ( tvt + 1 ) * pmode->thgt * pmode->nbpl,
-            framebuf + tvt * pmode->thgt * pmode->nbpl,
-            ( tvb - tvt ) * pmode->thgt * pmode->nbpl);
-        memset (framebuf + tvt * pmode->thgt * pmode->nbpl, bgfill, pmode->thgt * pmode->nbpl);
+        int nb = pmode->thgt * pmode->nbpl;
+        if ( fbroll () )
+            {
+#ifdef VDU_ROLL
+            yorg -= pmode->thgt;
+            if ( yorg < 0 ) yorg += pmode->grow;
+            VDU_ROLL (yorg);
+#endif
+            }
+        else
+            {
+            for (int ir = tvb; ir > tvt; --ir)
+                memcpy (fbrow (ir * pmode->thgt), fbrow (( ir - 1 ) * pmode->thgt), nb);
+            }
+        memset (fbrow (tvt * pmode->thgt), bgfill, nb);
 #ifdef VDU_SCROLL
         VDU_SCROLL (framebuf, tvt, tvb, false);
 #else
@@ -317,21 +458,19 @@ void scrldn (void)
     else
         {
         uint8_t bgfill = (uint8_t) cdef->cpx[txtbak];
-        uint8_t *fb1 = framebuf + tvb * pmode->thgt * pmode->nbpl
-            + ( tvl << cdef->bitsh );
-        uint8_t *fb2 = fb1 + pmode->thgt * pmode->nbpl;
+        int xb = tvl << cdef->bitsh;
+        int yp = ( tvb + 1 ) * pmode->thgt;
         int nr = ( tvb - tvt ) * pmode->thgt;
         int nb = ( tvr - tvl + 1 ) << cdef->bitsh;
         for (int ir = 0; ir < nr; ++ir)
             {
-            fb1 -= pmode->nbpl;
-            fb2 -= pmode->nbpl;
-            memcpy (fb2, fb1, nb);
+            --yp;
+            memcpy (fbrow (yp) + xb, fbrow (yp - pmode->thgt) + xb, nb);
             }
         for (int ir = 0; ir < pmode->thgt; ++ir)
             {
-            fb2 -= pmode->nbpl;
-            memset (fb2, bgfill, nb);
+            --yp;
+            memset (fbrow (yp) + xb, bgfill, nb);
             }
         VDU_OUT (framebuf, tvl << 3, tvt * pmode->thgt, (tvr + 1) << 3, (tvb + 1) * pmode->thgt);
         }
@@ -371,10 +510,21 @@ void scrlup (void)
     else if (( tvl == 0 ) && ( tvr == pmode->tcol - 1 ))
         {
         uint8_t bgfill = (uint8_t) cdef->cpx[txtbak];
-        memmove (framebuf + tvt * pmode->thgt * pmode->nbpl,
-            framebuf + ( tvt + 1 ) * pmode->thgt * pmode->nbpl,
-            ( tvb - tvt ) * pmode->thgt * pmode->nbpl);
-        memset (framebuf + tvb * pmode->thgt * pmode->nbpl, bgfill, pmode->thgt * pmode->nbpl);
+        int nb = pmode->thgt * pmode->nbpl;
+        if ( fbroll () )
+            {
+#ifdef VDU_ROLL
+            yorg += pmode->thgt;
+            if ( yorg >= pmode->grow ) yorg -= pmode->grow;
+            VDU_ROLL (yorg);
+#endif
+            }
+        else
+            {
+            for (int ir = tvt; ir < tvb; ++ir)
+                memcpy (fbrow (ir * pmode->thgt), fbrow (( ir + 1 ) * pmode->thgt), nb);
+            }
+        memset (fbrow (tvb * pmode->thgt), bgfill, nb);
 #ifdef VDU_SCROLL
         VDU_SCROLL (framebuf, tvt, tvb, true);
 #else
@@ -384,21 +534,19 @@ void scrlup (void)
     else
         {
         uint8_t bgfill = (uint8_t) cdef->cpx[txtbak];
-        uint8_t *fb1 = framebuf + tvt * pmode->thgt * pmode->nbpl
-            + ( tvl << cdef->bitsh );
-        uint8_t *fb2 = fb1 + pmode->thgt * pmode->nbpl;
+        int xb = tvl << cdef->bitsh;
+        int yp = tvt * pmode->thgt;
         int nr = ( tvb - tvt ) * pmode->thgt;
         int nb = ( tvr - tvl + 1 ) << cdef->bitsh;
         for (int ir = 0; ir < nr; ++ir)
             {
-            memcpy (fb1, fb2, nb);
-            fb1 += pmode->nbpl;
-            fb2 += pmode->nbpl;
+            memcpy (fbrow (yp) + xb, fbrow (yp + pmode->thgt) + xb, nb);
+            ++yp;
             }
         for (int ir = 0; ir < pmode->thgt; ++ir)
             {
-            memset (fb1, bgfill, nb);
-            fb1 += pmode->nbpl;
+            memset (fbrow (yp) + xb, bgfill, nb);
+            ++yp;
             }
         VDU_OUT (framebuf, tvl << 3, tvt * pmode->thgt, (tvr + 1) << 3, (tvb + 1) * pmode->thgt);
         }
@@ -430,21 +578,28 @@ void cls ()
     else if (( tvl == 0 ) && ( tvr == pmode->tcol - 1 ))
         {
         uint8_t bgfill = (uint8_t) cdef->cpx[txtbak];
-        memset (framebuf + tvt * pmode->thgt * pmode->nbpl, bgfill,
-            ( tvb - tvt + 1 ) * pmode->thgt * pmode->nbpl);
+        if ( fbroll () )
+            {
+#ifdef VDU_ROLL
+            yorg = 0;
+            VDU_ROLL (yorg);
+#endif
+            }
+        for (int ir = tvt; ir <= tvb; ++ir)
+            memset (fbrow (ir * pmode->thgt), bgfill, pmode->thgt * pmode->nbpl);
         VDU_OUT (framebuf, tvl << 3, tvt * pmode->thgt, (tvr + 1) << 3, (tvb + 1) * pmode->thgt);
         }
     else
         {
         uint8_t bgfill = (uint8_t) cdef->cpx[txtbak];
-        uint8_t *fb1 = framebuf + tvt * pmode->thgt * pmode->nbpl
-            + ( tvl << cdef->bitsh );
+        int xb = tvl << cdef->bitsh;
+        int yp = tvt * pmode->thgt;
         int nr = ( tvb - tvt + 1 ) * pmode->thgt;
         int nb = ( tvr - tvl + 1 ) << cdef->bitsh;
         for (int ir = 0; ir < nr; ++ir)
             {
-            memset (fb1, bgfill, nb);
-            fb1 += pmode->nbpl;
+            memset (fbrow (yp) + xb, bgfill, nb);
+            ++yp;
             }
         VDU_OUT (framebuf, tvl << 3, tvt * pmode->thgt, (tvr + 1) << 3, (tvb + 1) * pmode->thgt);
         }
@@ -458,72 +613,89 @@ void disp_ttx (char chr)
     VDU_OUT7 (framebuf, xcsr, ycsr, xcsr, ycsr);
     }
 
-void disp_glyph (uint8_t *pch)
+// Character definitions changed - discard cached glyphs:
+void newglyph (void)
     {
-    uint32_t fhgt = pmode->thgt;
-    bool bDbl = false;
-    if ( fhgt > 10 )
+#if GLYPH_CACHE > 0
+    for (int i = 0; i < (1 << GLYPH_CACHE); ++i)
+        glyphs[i].pch = NULL;
+#endif
+    }
+
+// Expand the rows of a glyph to pixels in the current text colours:
+static const uint32_t *glyph_pix (const uint8_t *pch)
+    {
+#if GLYPH_CACHE > 0
+    GLYPH *pgl = &glyphs[(((uintptr_t) pch >> 3) ^ (txtfor << 2) ^ (txtbak << 4))
+        & ((1 << GLYPH_CACHE) - 1)];
+    if (( pgl->pch == pch ) && ( pgl->fg == txtfor ) && ( pgl->bg == txtbak ))
+        return pgl->pix;
+    pgl->pch = pch;
+    pgl->fg = txtfor;
+    pgl->bg = txtbak;
+    uint32_t *pix = pgl->pix;
+#else
+    static uint32_t pix[8];
+#endif
+    uint32_t fpx = cdef->cpx[txtfor];
+    uint32_t bpx = cdef->cpx[txtbak];
+    for (int i = 0; i < 8; ++i)
         {
-        fhgt /= 2;
-        bDbl = true;
+        uint32_t mask;
+        if ( pmode->ncbt == 1 )         mask = pmsk02[pch[i]];
+        else if ( pmode->ncbt == 2 )    mask = pmsk04[pch[i]];
+        else                            mask = pmsk16[pch[i]];
+        pix[i] = ( mask & fpx ) | ( (~ mask) & bpx );
         }
-    fhgt = 8;
-    uint8_t *pfb = framebuf + ycsr * pmode->thgt * pmode->nbpl;
+    return pix;
+    }
+
+void disp_glyph (uint8_t *pch)
+    {
+    bool bDbl = ( pmode->thgt > 10 );
+    int nbpl = pmode->nbpl;
+    const uint32_t *pix = glyph_pix (pch);
+    uint8_t *pfb = fbrow (ycsr * pmode->thgt);
     if ( pmode->ncbt == 1 )
         {
         pfb += xcsr;
-        uint8_t fpx = (uint8_t) cdef->cpx[txtfor];
-        uint8_t bpx = (uint8_t) cdef->cpx[txtbak];
-        for (int i = 0; i < fhgt; ++i)
-            {
-            uint8_t mask = pmsk02[*pch];
-            uint8_t pix = ( mask & fpx ) | ( (~ mask ) & bpx );
-            *pfb = pix;
-            pfb += pmode->nbpl;
+        for (int i = 0; i < 8; ++i)
+            {
+            *pfb = (uint8_t) pix[i];
+            pfb += nbpl;
             if ( bDbl )
                 {
-                *pfb = pix;
-                pfb += pmode->nbpl;
+                *pfb = (uint8_t) pix[i];
+                pfb += nbpl;
                 }
-            ++pch;
             }
         }
     else if ( pmode->ncbt == 2 )
         {
         pfb += 2 * xcsr;
-        uint16_t fpx = cdef->cpx[txtfor];
-        uint16_t bpx = cdef->cpx[txtbak];
-        for (int i = 0; i < fhgt; ++i)
-            {
-            uint16_t mask = pmsk04[*pch];
-            uint16_t pix = ( mask & fpx ) | ( (~ mask) & bpx );
-            *((uint16_t *)pfb) = pix;
-            pfb += pmode->nbpl;
+        for (int i = 0; i < 8; ++i)
+            {
+            *((uint16_t *)pfb) = (uint16_t) pix[i];
+            pfb += nbpl;
             if ( bDbl )
                 {
-                *((uint16_t *)pfb) = pix;
-                pfb += pmode->nbpl;
+                *((uint16_t *)pfb) = (uint16_t) pix[i];
+                pfb += nbpl;
                 }
-            ++pch;
             }
         }
     else if ( pmode->ncbt == 4 )
         {
         pfb += 4 * xcsr;
-        uint32_t fpx = cdef->cpx[txtfor];
-        uint32_t bpx = cdef->cpx[txtbak];
-        for (int i = 0; i < fhgt; ++i)
-            {
-            uint32_t mask = pmsk16[*pch];
-            uint32_t pix = ( mask & fpx ) | ( (~ mask) & bpx );
-            *((uint32_t *)pfb) = pix;
-            pfb += pmode->nbpl;
+        for (int i = 0; i < 8; ++i)
+            {
+            *((uint32_t *)pfb) = pix[i];
+            pfb += nbpl;
             if ( bDbl )
                 {
-                *((uint32_t *)pfb) = pix;
-                pfb += pmode->nbpl;
+                *((uint32_t *)pfb) = pix[i];
+                pfb += nbpl;
                 }
-            ++pch;
             }
         }
     VDU_OUT (framebuf, xcsr << 3, ycsr * pmode->thgt, (xcsr + 1) << 3, (ycsr + 1) * pmode->thgt);
@@ -561,12 +733,13 @@ static inline void pixop (int op, uint32_t *fb, uint32_t msk, uint32_t cpx)
         }
     }
 
-void hline (int clrop, int xp1, int xp2, int yp)
+// Draw a span of pixels without updating the display:
+void hspan (int clrop, int xp1, int xp2, int yp)
     {
     int op = clrop >> 8;
     int xb1 = xp1 << cdef->bitsh;
     int xb2 = xp2 << cdef->bitsh;
-    uint32_t *fb1 = (uint32_t *)(framebuf + yp * pmode->nbpl);
+    uint32_t *fb1 = (uint32_t *) fbrow (yp);
     uint32_t *fb2 = fb1 + ( xb2 >> 5 );
     fb1 += ( xb1 >> 5 );
     uint32_t msk1 = fwdmsk[xb1 & 0x1F];
@@ -587,9 +760,56 @@ void hline (int clrop, int xp1, int xp2, int yp)
             }
         pixop (op, fb1, msk2, cpx);
         }
+    }
+
+void hline (int clrop, int xp1, int xp2, int yp)
+    {
+    hspan (clrop, xp1, xp2, yp);
+#ifdef VDU_OUT
+    if ( bSpans )
+        {
+        if (( ys2 > ys1 ) && (( yp == ys2 ) || ( yp + 1 == ys1 ))
+            && ( xp1 <= xs2 ) && ( xp2 + 1 >= xs1 ))
+            {
+            if ( xp1 < xs1 ) xs1 = xp1;
+            if ( xp2 + 1 > xs2 ) xs2 = xp2 + 1;
+            if ( yp < ys1 ) ys1 = yp;
+            else if ( yp == ys2 ) ys2 = yp + 1;
+            return;
+            }
+        spanout ();
+        xs1 = xp1;
+        xs2 = xp2 + 1;
+        ys1 = yp;
+        ys2 = yp + 1;
+        return;
+        }
+#endif
     VDU_OUT (framebuf, xp1, yp, xp2 + 1, yp + 1);
     }
 
+// Update the display for a rectangle drawn by hspan (exclusive at right and bottom):
+void rectout (int xp1, int yp1, int xp2, int yp2)
+    {
+#ifdef VDU_OUT
+    if ( bSpans ) spanout ();
+#endif
+    VDU_OUT (framebuf, xp1, yp1, xp2, yp2);
+    }
+
+// Merge the display updates for spans on adjacent rows (when replaying the VDU queue):
+void hlbatch (bool bBatch)
+    {
+#ifdef VDU_OUT
+    if ( ! bBatch )
+        {
+        spanout ();
+        dirtyout ();
+        }
+    bSpans = bBatch;
+#endif
+    }
+
 void clrgraph (void)
     {
     for (int yp = gvt; yp <= gvb; ++yp)
@@ -603,7 +823,7 @@ void point (int clrop, uint32_t xp, uint32_t yp)
 #if DEBUG & 4
     printf ("point (0x%04X, %d, %d)\n", clrop, xp, yp);
 #endif
-    uint32_t *fb = (uint32_t *)(framebuf + yp * pmode->nbpl);
+    uint32_t *fb = (uint32_t *) fbrow (yp);
     uint32_t xb = xp << cdef->bitsh;
     fb += xb >> 5;
     xb &= 0x1F;
@@ -618,7 +838,7 @@ void point (int clrop, uint32_t xp, uint32_t yp)
 
 uint8_t getpix (int xp, int yp)
     {
-    uint32_t *fb = (uint32_t *)(framebuf + yp * pmode->nbpl);
+    uint32_t *fb = (uint32_t *) fbrow (yp);
     xp <<= cdef->bitsh;
     fb += xp >> 5;
     xp &= 0x1F;
@@ -627,6 +847,378 @@ uint8_t getpix (int xp, int yp)
     return pix;
     }
 
+/*  Tables for finding runs of pixels to flood fill. For each byte value, the number of
+    consecutive pixels with colours in the set, counting from the left (low) and right
+    (high) ends of the byte. If the set is a single colour, whole words are tested by
+    comparing with that colour, otherwise by looking up each byte.
+*/
+static uint32_t fillset = 0;                // Set of colours for which the tables are valid
+static const CLRDEF *fillcdef = NULL;       // Colour definition for which the tables are valid
+static uint8_t fillrun[2][256];             // Pixels in set from each end of byte
+static int fillone;                         // The only colour in the set, otherwise negative
+
+static void fillinit (uint32_t inset)
+    {
+    int bitsh = cdef->bitsh;
+    int nppb = 8 >> bitsh;
+    fillset = inset;
+    fillcdef = cdef;
+    fillone = -1;
+    for (int i = 0; i <= cdef->clrmsk; ++i)
+        {
+        if ( inset & (1 << i) )
+            {
+            if ( fillone < 0 ) fillone = i;
+            else fillone = -2;
+            }
+        }
+    for (int b = 0; b < 256; ++b)
+        {
+        int n = 0;
+        while (( n < nppb ) && ( inset & (1 << (( b >> ( n << bitsh )) & cdef->clrmsk )) )) ++n;
+        fillrun[0][b] = n;
+        n = 0;
+        while (( n < nppb ) && ( inset & (1 << (( b >> (( nppb - 1 - n ) << bitsh )) & cdef->clrmsk )) )) ++n;
+        fillrun[1][b] = n;
+        }
+    }
+
+// Test whether all the pixels of a word have colours in the set:
+static inline bool fillword (uint32_t w)
+    {
+    if ( fillone >= 0 ) return ( w == cdef->cpx[fillone] );
+    int nppb = 8 >> cdef->bitsh;
+    return ( fillrun[0][w & 0xFF] == nppb ) && ( fillrun[0][(w >> 8) & 0xFF] == nppb )
+        && ( fillrun[0][(w >> 16) & 0xFF] == nppb ) && ( fillrun[0][w >> 24] == nppb );
+    }
+
+/*  Find the run of pixels on row yp, starting at xp and moving towards xlim, with colours
+    in the set 'inset' (bit n set for colour n). Returns the number of pixels in the run.
+*/
+int fillscan (int xp, int yp, int xlim, uint32_t inset)
+    {
+    if (( inset != fillset ) || ( cdef != fillcdef )) fillinit (inset);
+    const uint8_t *prow = fbrow (yp);
+    int bitsh = cdef->bitsh;
+    int nppb = 8 >> bitsh;
+    int nppw = 32 >> bitsh;
+    int x = xp;
+    if ( xlim >= xp )
+        {
+        while ( x <= xlim )
+            {
+            int xb = x << bitsh;
+            if ((( xb & 0x1F ) == 0 ) && ( x + nppw - 1 <= xlim )
+                && fillword (*((const uint32_t *)(prow + (xb >> 3)))))
+                {
+                x += nppw;
+                }
+            else if ((( xb & 0x07 ) == 0 ) && ( x + nppb - 1 <= xlim ))
+                {
+                int n = fillrun[0][prow[xb >> 3]];
+                x += n;
+                if ( n < nppb ) break;
+                }
+            else if ( inset & (1 << (( prow[xb >> 3] >> ( xb & 0x07 )) & cdef->clrmsk )) )
+                {
+                ++x;
+                }
+            else break;
+            }
+        return x - xp;
+        }
+    while ( x >= xlim )
+        {
+        int xb = ( x + 1 ) << bitsh;
+        if ((( xb & 0x1F ) == 0 ) && ( x - nppw + 1 >= xlim )
+            && fillword (*((const uint32_t *)(prow + (xb >> 3) - 4))))
+            {
+            x -= nppw;
+            }
+        else if ((( xb & 0x07 ) == 0 ) && ( x - nppb + 1 >= xlim ))
+            {
+            int n = fillrun[1][prow[(xb >> 3) - 1]];
+            x -= n;
+            if ( n < nppb ) break;
+            }
+        else
+            {
+            xb -= 1 << bitsh;
+            if ( inset & (1 << (( prow[xb >> 3] >> ( xb & 0x07 )) & cdef->clrmsk )) ) --x;
+            else break;
+            }
+        }
+    return xp - x;
+    }
+
+/*  Sprites. Each sprite is defined from a bitmap in the pixel format of the current mode,
+    with each row padded to a whole number of bytes. The rows are held padded to whole
+    words, together with a mask of the pixels which are not the transparent colour.
+    Sprites are drawn a word at a time, shifting the pixels and mask to the screen
+    position, and the background under each sprite is saved so that it can be restored
+    when the sprite is moved or hidden.
+
+    Sprites are drawn in order of number. Moving or hiding a sprite first removes any
+    higher numbered sprites overlapping it, and then redraws them, so that the saved
+    backgrounds remain correct. Drawing over a sprite by other means is not tracked.
+
+    The definitions are discarded on a change of mode.
+*/
+#ifndef NSPRITE
+#define NSPRITE 16                          // Number of sprites
+#endif
+
+typedef struct
+    {
+    uint32_t    *pix;                       // Pixel rows, followed by mask rows and saved background
+    short       w, h;                       // Size in pixels
+    short       nw;                         // Words per row
+    short       x, y;                       // Position of top left corner
+    short       xs1, ys1, xs2, ys2;         // Visible part of sprite (inclusive)
+    uint8_t     op;                         // Plot action
+    bool        bShow;                      // Sprite is displayed
+    } SPRITE;
+
+static SPRITE sprites[NSPRITE];
+
+// Bits sb to sb + 31 of a sprite row, zero outside the sprite:
+static inline uint32_t sprword (const uint32_t *prow, int nw, int sb)
+    {
+    int k = sb >> 5;
+    int r = sb & 0x1F;
+    uint32_t w = ( k >= 0 ) && ( k < nw ) ? prow[k] : 0;
+    if ( r == 0 ) return w;
+    w >>= r;
+    ++k;
+    if (( k >= 0 ) && ( k < nw )) w |= prow[k] << ( 32 - r );
+    return w;
+    }
+
+// Word range and edge masks of the visible part of a sprite:
+static void sprspan (const SPRITE *ps, int *pj1, int *pj2, uint32_t *pm1, uint32_t *pm2)
+    {
+    int xb1 = ps->xs1 << cdef->bitsh;
+    int xb2 = (( ps->xs2 + 1 ) << cdef->bitsh ) - 1;
+    *pj1 = xb1 >> 5;
+    *pj2 = xb2 >> 5;
+    *pm1 = fwdmsk[xb1 & 0x1F];
+    *pm2 = bkwmsk[xb2 & 0x1F];
+    }
+
+// Save the background under a sprite and draw it:
+static void sprdraw (SPRITE *ps)
+    {
+    int nw = ps->nw;
+    int xb = ps->x * ( 1 << cdef->bitsh );
+    const uint32_t *pmsk = ps->pix + nw * ps->h;
+    uint32_t *psave = ps->pix + 2 * nw * ps->h;
+    int j1, j2;
+    uint32_t m1, m2;
+    sprspan (ps, &j1, &j2, &m1, &m2);
+    for (int yp = ps->ys1; yp <= ps->ys2; ++yp)
+        {
+        uint32_t *fb = (uint32_t *) fbrow (yp);
+        int iRow = nw * ( yp - ps->y );
+        for (int j = j1; j <= j2; ++j)
+            {
+            int sb = 32 * j - xb;
+            uint32_t msk = sprword (pmsk + iRow, nw, sb);
+            if ( j == j1 ) msk &= m1;
+            if ( j == j2 ) msk &= m2;
+            *psave = fb[j];
+            ++psave;
+            pixop (ps->op, &fb[j], msk, sprword (ps->pix + iRow, nw, sb));
+            }
+        }
+    }
+
+// Restore the background under a sprite:
+static void sprerase (SPRITE *ps)
+    {
+    int nw = ps->nw;
+    int xb = ps->x * ( 1 << cdef->bitsh );
+    const uint32_t *pmsk = ps->pix + nw * ps->h;
+    const uint32_t *psave = ps->pix + 2 * nw * ps->h;
+    int j1, j2;
+    uint32_t m1, m2;
+    sprspan (ps, &j1, &j2, &m1, &m2);
+    for (int yp = ps->ys1; yp <= ps->ys2; ++yp)
+        {
+        uint32_t *fb = (uint32_t *) fbrow (yp);
+        int iRow = nw * ( yp - ps->y );
+        for (int j = j1; j <= j2; ++j)
+            {
+            uint32_t msk = sprword (pmsk + iRow, nw, 32 * j - xb);
+            if ( j == j1 ) msk &= m1;
+            if ( j == j2 ) msk &= m2;
+            fb[j] = ( fb[j] & ~msk ) | ( *psave & msk );
+            ++psave;
+            }
+        }
+    }
+
+// Clip a sprite to the graphics viewport, returns false if not visible:
+static bool sprclip (SPRITE *ps)
+    {
+    ps->xs1 = ( ps->x > gvl ) ? ps->x : gvl;
+    ps->ys1 = ( ps->y > gvt ) ? ps->y : gvt;
+    ps->xs2 = ( ps->x + ps->w - 1 < gvr ) ? ps->x + ps->w - 1 : gvr;
+    ps->ys2 = ( ps->y + ps->h - 1 < gvb ) ? ps->y + ps->h - 1 : gvb;
+    return ( ps->xs1 <= ps->xs2 ) && ( ps->ys1 <= ps->ys2 );
+    }
+
+static inline bool sprover (const SPRITE *ps1, const SPRITE *ps2)
+    {
+    return ( ps1->xs1 <= ps2->xs2 ) && ( ps1->xs2 >= ps2->xs1 )
+        && ( ps1->ys1 <= ps2->ys2 ) && ( ps1->ys2 >= ps2->ys1 );
+    }
+
+// Report the visible part of a sprite as changed:
+static inline void sprdirty (const SPRITE *ps)
+    {
+#ifdef VDU_OUT
+    dirtyadd (ps->xs1, ps->ys1, ps->xs2 + 1, ps->ys2 + 1);
+#endif
+    }
+
+/*  Move (or hide) sprite n. The sprite and all higher numbered sprites overlapping
+    it (directly or through each other) are erased in reverse order, then redrawn
+    in order with sprite n at its new position.
+*/
+static void sprmove (int n, bool bShow, int xp, int yp, int op)
+    {
+    if (( n < 0 ) || ( n >= NSPRITE ) || ( sprites[n].pix == NULL )) return;
+    SPRITE *ps = &sprites[n];
+    bool bLift[NSPRITE];
+    SPRITE snew = *ps;
+    if ( bShow )
+        {
+        snew.x = xp;
+        snew.y = yp;
+        snew.op = op;
+        snew.bShow = sprclip (&snew);
+        }
+    else
+        {
+        snew.bShow = false;
+        }
+    memset (bLift, 0, sizeof (bLift));
+    bLift[n] = ps->bShow;
+    for (int i = n + 1; i < NSPRITE; ++i)
+        {
+        if ( ! sprites[i].bShow ) continue;
+        if ( snew.bShow && sprover (&sprites[i], &snew) ) bLift[i] = true;
+        for (int j = n; ( j < i ) && ( ! bLift[i] ); ++j)
+            {
+            if ( bLift[j] && sprover (&sprites[i], &sprites[j]) ) bLift[i] = true;
+            }
+        }
+    for (int i = NSPRITE - 1; i >= n; --i)
+        {
+        if ( bLift[i] )
+            {
+            sprerase (&sprites[i]);
+            sprdirty (&sprites[i]);
+            }
+        }
+    *ps = snew;
+    bLift[n] = ps->bShow;
+    for (int i = n; i < NSPRITE; ++i)
+        {
+        if ( bLift[i] )
+            {
+            sprdraw (&sprites[i]);
+            sprdirty (&sprites[i]);
+            }
+        }
+#ifdef VDU_OUT
+    if ( ! bSpans ) dirtyout ();
+#endif
+    }
+
+// Discard all sprite definitions (without erasing them):
+static void sprfree (void)
+    {
+    for (int i = 0; i < NSPRITE; ++i)
+        {
+        free (sprites[i].pix);
+        sprites[i].pix = NULL;
+        sprites[i].bShow = false;
+        }
+    }
+
+/*  Define sprite n as w by h pixels, from a bitmap in the format of the current mode,
+    which must lie in user memory. Pixels of colour key are transparent (key > maximum
+    colour for none).
+    Returns an error message on failure.
+*/
+const char *sprdef (int n, int w, int h, int key, const uint8_t *bits)
+    {
+    if (( n < 0 ) || ( n >= NSPRITE ) || ( w <= 0 ) || ( h <= 0 )
+        || ( w > pmode->gcol ) || ( h > pmode->grow )) return "Invalid sprite";
+    if ( cdef->cpx == NULL ) return "Sprites not available in this mode";
+    int bitsh = cdef->bitsh;
+    int nb = (( w << bitsh ) + 7 ) >> 3;
+    // The bitmap address comes from BASIC, so it must lie wholly within user memory
+    if (( bits < (const uint8_t *) userRAM ) || ( bits >= (const uint8_t *) userTOP )
+        || ( nb * h > (const uint8_t *) userTOP - bits )) return "Address out of range";
+    sprhide (n);
+    SPRITE *ps = &sprites[n];
+    int nw = ( nb + 3 ) >> 2;
+    free (ps->pix);
+    ps->pix = (uint32_t *) malloc (( 3 * nw + 1 ) * h * sizeof (uint32_t));
+    if ( ps->pix == NULL ) return "No room for sprite";
+    ps->w = w;
+    ps->h = h;
+    ps->nw = nw;
+    uint8_t *ppix = (uint8_t *) ps->pix;
+    uint32_t *pmsk = ps->pix + nw * h;
+    memset (ps->pix, 0, 2 * nw * h * sizeof (uint32_t));
+    for (int yp = 0; yp < h; ++yp)
+        {
+        memcpy (ppix, bits, nb);
+        for (int xp = 0; xp < w; ++xp)
+            {
+            int xb = xp << bitsh;
+            if ((( bits[xb >> 3] >> ( xb & 0x07 )) & cdef->clrmsk ) != key )
+                pmsk[xb >> 5] |= cdef->clrmsk << ( xb & 0x1F );
+            }
+        ppix += 4 * nw;
+        pmsk += nw;
+        bits += nb;
+        }
+    return NULL;
+    }
+
+// Display sprite n with its top left corner at pixel (xp, yp), using plot action op:
+void sprshow (int n, int xp, int yp, int op)
+    {
+    sprmove (n, true, xp, yp, op);
+    }
+
+// Remove sprite n from the display:
+void sprhide (int n)
+    {
+    sprmove (n, false, 0, 0, 0);
+    }
+
+// Remove all sprites from the display and discard their definitions:
+void sprclear (void)
+    {
+    for (int i = NSPRITE - 1; i >= 0; --i)
+        {
+        if ( sprites[i].bShow )
+            {
+            sprerase (&sprites[i]);
+            sprdirty (&sprites[i]);
+            }
+        }
+#ifdef VDU_OUT
+    if ( ! bSpans ) dirtyout ();
+#endif
+    sprfree ();
+    }
+
 int get_ttx (int x, int y)
     {
     int chr = framebuf[y * pmode->tcol + x];
@@ -837,7 +1429,7 @@ int sdump (FILE *fBmp)
         }
     for (int iRow = pmode->grow - 1; iRow >= 0 ; --iRow)
         {
-        uint8_t *fp = framebuf + pmode->nbpl * iRow;
+        uint8_t *fp = fbrow (iRow);
         uint8_t *fpEnd = fp + pmode->nbpl;
         while ( fp < fpEnd )
             {
@@ -883,7 +1475,7 @@ int sload (FILE *fBmp)
         }
     for (int iRow = pmode->grow - 1; iRow >= 0 ; --iRow)
         {
-        uint8_t *fp = framebuf + pmode->nbpl * iRow;
+        uint8_t *fp = fbrow (iRow);
         uint8_t *fpEnd = fp + pmode->nbpl;
         while ( fp < fpEnd )
             {
@@ -899,6 +1491,57 @@ int sload (FILE *fBmp)
     return 0;
     }
 
+// Save the screen as a run length compressed file, in the framebuffer format:
+int sdumprle (FILE *fRle)
+    {
+    SRLE srle;
+    int rgb[16];
+    int nClr = ( pmode->ncbt == 3 ) ? 0 : 1 << pmode->ncbt;
+    for (int iClr = 0; iClr < nClr; ++iClr) rgb[iClr] = clrrgb (iClr);
+    int iErr;
+    if ( pmode->ncbt == 3 )
+        {
+        iErr = srle_wrhdr (&srle, fRle, pmode->tcol, pmode->trow, pmode->ncbt, nClr, rgb);
+        for (int iRow = 0; ( iErr == 0 ) && ( iRow < pmode->trow ); ++iRow)
+            iErr = srle_wrrow (&srle, framebuf + iRow * pmode->tcol, pmode->tcol);
+        }
+    else
+        {
+        iErr = srle_wrhdr (&srle, fRle, pmode->gcol, pmode->grow, pmode->ncbt, nClr, rgb);
+        for (int iRow = 0; ( iErr == 0 ) && ( iRow < pmode->grow ); ++iRow)
+            iErr = srle_wrrow (&srle, fbrow (iRow), pmode->nbpl);
+        }
+    if ( iErr == 0 ) iErr = srle_wrend (&srle);
+    return iErr;
+    }
+
+// Load a run length compressed screen, decompressing straight into the framebuffer:
+int sloadrle (FILE *fRle)
+    {
+    SRLE srle;
+    int rgb[16];
+    int nClr = ( pmode->ncbt == 3 ) ? 0 : 1 << pmode->ncbt;
+    int iErr;
+    if ( pmode->ncbt == 3 )
+        {
+        iErr = srle_rdhdr (&srle, fRle, pmode->tcol, pmode->trow, pmode->ncbt, nClr, rgb);
+        for (int iRow = 0; ( iErr == 0 ) && ( iRow < pmode->trow ); ++iRow)
+            iErr = srle_rdrow (&srle, framebuf + iRow * pmode->tcol, pmode->tcol);
+        VDU_OUT7 (framebuf, 0, 0, pmode->tcol - 1, pmode->trow - 1);
+        return iErr;
+        }
+    iErr = srle_rdhdr (&srle, fRle, pmode->gcol, pmode->grow, pmode->ncbt, nClr, rgb);
+    if ( iErr ) return iErr;
+    for (int iClr = 0; iClr < nClr; ++iClr)
+        {
+        clrset (iClr, 16, rgb[iClr] & 0xFF, (rgb[iClr] >> 8) & 0xFF, (rgb[iClr] >> 16) & 0xFF);
+        }
+    for (int iRow = 0; ( iErr == 0 ) && ( iRow < pmode->grow ); ++iRow)
+        iErr = srle_rdrow (&srle, fbrow (iRow), pmode->nbpl);
+    VDU_OUT (framebuf, 0, 0, pmode->gcol, pmode->grow);
+    return iErr;
+    }
+
 void prtscrn (void)
     {
     static int iPrt = 0;
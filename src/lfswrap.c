@@ -1227,7 +1227,7 @@ int mount (char *psMsg)
 #if SERIAL_DEV != 0
 static bool parse_sconfig (const char *ps, SERIAL_CONFIG *sc)
     {
-    static const char *psPar[] = { "baud", "parity", "data", "stop", "tx", "rx", "cts", "rts"};
+    static const char *psPar[] = { "baud", "parity", "data", "stop", "tx", "rx", "cts", "rts", "rxbuf", "txbuf", "dma"};
     int iPar = 0;
     memset (sc, -1, sizeof (SERIAL_CONFIG));
 #if DEBUG
@@ -1302,8 +1302,8 @@ static bool parse_sconfig (const char *ps, SERIAL_CONFIG *sc)
     if ( sc->stop < 0 ) sc->stop = 1;
     if ( sc->parity < 0 ) sc->parity = UART_PARITY_NONE;
 #if DEBUG
-    dbgmsg ("sconfig (%d, %d, %d, %d, %d, %d, %d, %d)\r\n", sc->baud, sc->parity, sc->data, sc->stop,
-        sc->tx, sc->rx, sc->cts, sc->rts);
+    dbgmsg ("sconfig (%d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d)\r\n", sc->baud, sc->parity, sc->data, sc->stop,
+        sc->tx, sc->rx, sc->cts, sc->rts, sc->rxbuf, sc->txbuf, sc->dma);
 #endif
     return true;
     }
@@ -0,0 +1,126 @@
+// gpioevt.c - Interrupt driven GPIO edge events for BASIC
+
+/*  Each enabled edge on a GPIO pin is recorded by the interrupt, with the time,
+    in a ring of GEVT_LEN entries, and ALERT is set. At the next statement boundary
+    xtrap calls gpio_event_post, which passes the events to the ON SYS handler with:
+
+        @msg%       WM_GPIO
+        @wparam%    GPIO number + 256 * edges (4 = falling, 8 = rising)
+        @lparam%    Time of interrupt (microseconds, from time_us_32)
+
+    If there is no ON SYS handler the events stay in the ring, and may be read with
+    gpio_event_get. The interrupt is the only writer and BASIC the only reader, so
+    the ring needs no locking. Only GPIOs 0 - 31 are supported. The pin must already
+    be configured as an input.
+*/
+
+#include <string.h>
+#include <hardware/gpio.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
+#include <hardware/timer.h>
+#include "BBC.h"
+#include "gpioevt.h"
+
+int putevt (heapptr handler, int msg, int wparam, int lparam);
+
+#define GEVT_EDGES  ( GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE )
+
+static GPIO_EVENT gevt[GEVT_LEN];
+static volatile int grptr = 0;          // Next event to read (advanced by BASIC)
+static volatile int gwptr = 0;          // Next free entry (advanced by interrupt)
+static uint32_t gevt_mask = 0;          // GPIOs with events enabled
+static GPIO_EVT_STATS gst;
+
+static void gevt_irq (void)
+    {
+    uint32_t t = time_us_32 ();
+    uint32_t pins = gevt_mask;
+    while ( pins )
+        {
+        uint pin = __builtin_ctz (pins);
+        pins &= pins - 1;
+        uint32_t edge = gpio_get_irq_event_mask (pin) & GEVT_EDGES;
+        if ( edge == 0 ) continue;
+        gpio_acknowledge_irq (pin, edge);
+        ++gst.nevent;
+        int wptr = gwptr;
+        int wnext = ( wptr + 1 ) & ( GEVT_LEN - 1 );
+        if ( wnext == grptr )
+            {
+            ++gst.nlost;
+            continue;
+            }
+        gevt[wptr].time = t;
+        gevt[wptr].pin = pin;
+        gevt[wptr].edge = edge;
+        gwptr = wnext;
+        }
+    flags |= ALERT;
+    }
+
+bool gpio_event_enable (int pin, int edges)
+    {
+    if (( pin < 0 ) || ( pin >= 32 ) || ( pin >= NUM_BANK0_GPIOS )) return false;
+    edges &= GEVT_EDGES;
+    uint32_t mask = gevt_mask;
+    if ( edges ) mask |= 1u << pin;
+    else mask &= ~ ( 1u << pin );
+    gpio_set_irq_enabled (pin, GEVT_EDGES, false);
+    if ( mask != gevt_mask )
+        {
+        if ( gevt_mask ) gpio_remove_raw_irq_handler_masked (gevt_mask, gevt_irq);
+        gevt_mask = mask;
+        if ( mask ) gpio_add_raw_irq_handler_masked (mask, gevt_irq);
+        }
+    if ( edges )
+        {
+        gpio_acknowledge_irq (pin, GEVT_EDGES);
+        gpio_set_irq_enabled (pin, edges, true);
+        irq_set_enabled (IO_IRQ_BANK0, true);
+        }
+    return true;
+    }
+
+static void gevt_done (const GPIO_EVENT *pe)
+    {
+    uint32_t tlat = time_us_32 () - pe->time;
+    ++gst.ndone;
+    gst.tlat += tlat;
+    if ( tlat > gst.tmax ) gst.tmax = tlat;
+    grptr = ( grptr + 1 ) & ( GEVT_LEN - 1 );
+    }
+
+bool gpio_event_get (GPIO_EVENT *pevt)
+    {
+    if ( grptr == gwptr ) return false;
+    *pevt = gevt[grptr];
+    gevt_done (pevt);
+    return true;
+    }
+
+// Called from xtrap. Stops if the BASIC event queue is full:
+void gpio_event_post (void)
+    {
+    if ( systrp == 0 ) return;
+    while ( grptr != gwptr )
+        {
+        const GPIO_EVENT *pe = &gevt[grptr];
+        if ( ! putevt (systrp, WM_GPIO, pe->pin | ( pe->edge << 8 ), pe->time) ) break;
+        gevt_done (pe);
+        }
+    }
+
+void gpio_event_stats (GPIO_EVT_STATS *ps)
+    {
+    uint32_t save = save_and_disable_interrupts ();
+    *ps = gst;
+    restore_interrupts (save);
+    }
+
+void gpio_event_reset (void)
+    {
+    uint32_t save = save_and_disable_interrupts ();
+    memset (&gst, 0, sizeof (gst));
+    restore_interrupts (save);
+    }
@@ -1,26 +1,128 @@
 // periodic.c - Queue periodic events.
 
+/*  A single repeating timer ticks at PRD_TICK_US. On each tick every task that is due
+    runs, in priority order. Each task has its own period. If a task (or those run
+    before it) takes so long that one or more of its periods have passed, the missed
+    periods are counted as overruns and skipped rather than run late.
+*/
+
 #include "periodic.h"
-#include <stdbool.h>
+#include <string.h>
 #include <pico/time.h>
+#include <pico/sync.h>
+
+typedef struct
+    {
+    PRD_FUNC    fn;                     // Task routine, NULL if slot free
+    uint32_t    period;                 // Period (microseconds)
+    uint32_t    tdue;                   // Time next due
+    int         prio;                   // Priority, lower runs first
+    PRD_STATS   st;                     // Accounting
+    } PRD_TASK;
 
-static PRD_FUNC ptop = NULL;
+static PRD_TASK task[NPRD];
+static uint8_t order[NPRD];             // Task slots in priority order
+static int ntask = 0;
+static bool bInit = false;
+static critical_section_t cs_prd;
 static struct repeating_timer s_prd_timer;
 
 static bool periodic_cb (struct repeating_timer *prt)
     {
-    if (ptop != NULL) ptop ();
+    uint8_t run[NPRD];
+    critical_section_enter_blocking (&cs_prd);
+    int nrun = ntask;
+    memcpy (run, order, nrun);
+    critical_section_exit (&cs_prd);
+    for (int i = 0; i < nrun; ++i)
+        {
+        PRD_TASK *pt = &task[run[i]];
+        PRD_FUNC fn = pt->fn;
+        if ( fn == NULL ) continue;
+        uint32_t t0 = time_us_32 ();
+        if ( (int32_t) (t0 - pt->tdue) < 0 ) continue;
+        fn ();
+        uint32_t t1 = time_us_32 ();
+        uint32_t tr = t1 - t0;
+        ++pt->st.nrun;
+        pt->st.tused += tr;
+        if ( tr > pt->st.tmax ) pt->st.tmax = tr;
+        pt->tdue += pt->period;
+        if ( (int32_t) (t1 - pt->tdue) >= 0 )
+            {
+            uint32_t nmiss = ( t1 - pt->tdue ) / pt->period + 1;
+            pt->st.nover += nmiss;
+            pt->tdue += nmiss * pt->period;
+            }
+        }
     return true;
     }
 
+int add_periodic (PRD_FUNC fn, int period, int prio)
+    {
+    if ( ! bInit )
+        {
+        critical_section_init (&cs_prd);
+        add_repeating_timer_us (- PRD_TICK_US, periodic_cb, NULL, &s_prd_timer);
+        bInit = true;
+        }
+    if ( period < 1 ) period = 1;
+    critical_section_enter_blocking (&cs_prd);
+    int id = 0;
+    while (( id < NPRD ) && ( task[id].fn != NULL )) ++id;
+    if ( id < NPRD )
+        {
+        PRD_TASK *pt = &task[id];
+        pt->period = 1000 * period;
+        pt->tdue = time_us_32 () + pt->period;
+        pt->prio = prio;
+        memset (&pt->st, 0, sizeof (pt->st));
+        pt->fn = fn;
+        int i = ntask;
+        while (( i > 0 ) && ( task[order[i-1]].prio > prio ))
+            {
+            order[i] = order[i-1];
+            --i;
+            }
+        order[i] = id;
+        ++ntask;
+        }
+    else
+        {
+        id = -1;
+        }
+    critical_section_exit (&cs_prd);
+    return id;
+    }
 
-PRD_FUNC add_periodic (PRD_FUNC new)
+void remove_periodic (int id)
     {
-    PRD_FUNC old = ptop;
-    if (ptop == NULL)
+    if (( id < 0 ) || ( id >= NPRD ) || ( ! bInit )) return;
+    critical_section_enter_blocking (&cs_prd);
+    if ( task[id].fn != NULL )
         {
-        add_repeating_timer_ms (100, periodic_cb, NULL, &s_prd_timer);
+        int i = 0;
+        while ( order[i] != id ) ++i;
+        --ntask;
+        memmove (&order[i], &order[i+1], ntask - i);
+        task[id].fn = NULL;
         }
-    ptop = new;
-    return old;
+    critical_section_exit (&cs_prd);
+    }
+
+bool periodic_stats (int id, PRD_STATS *ps)
+    {
+    if (( id < 0 ) || ( id >= NPRD ) || ( task[id].fn == NULL )) return false;
+    critical_section_enter_blocking (&cs_prd);
+    *ps = task[id].st;
+    critical_section_exit (&cs_prd);
+    return true;
+    }
+
+void periodic_reset (int id)
+    {
+    if (( id < 0 ) || ( id >= NPRD ) || ( ! bInit )) return;
+    critical_section_enter_blocking (&cs_prd);
+    memset (&task[id].st, 0, sizeof (task[id].st));
+    critical_section_exit (&cs_prd);
     }
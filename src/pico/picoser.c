@@ -5,51 +5,248 @@
 #include <hardware/structs/uart.h>
 #include <hardware/gpio.h>
 #include <hardware/irq.h>
+#include <hardware/dma.h>
+#include <pico/time.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
 #include "bbuart.h"
 
-#define NDATA   512     // Length of serial receive buffer (must be a power of 2)
+#define NDATA   512     // Default length of serial receive buffer
+#define NTXDATA 512     // Default length of serial transmit buffer
+#define NMAXBUF 16384   // Largest buffer that may be requested
+#define NDMABUF 4096    // Default length of receive buffer when using DMA
+#define NMINDMA 1024    // Shortest receive buffer when using DMA
+#define DMA_TICK_US 1000    // Interval for checking DMA receive progress
 
 typedef struct
     {
     uart_inst_t         *uart;
     critical_section_t  ucs;
-    char                data[NDATA];
+    char                *data;      // Receive ring
+    int                 rmask;      // Receive ring length - 1
     int                 rptr;
     int                 wptr;
+    int                 rhigh;      // Most bytes ever held in receive ring
+    char                *txdata;    // Transmit ring
+    int                 tmask;      // Transmit ring length - 1
+    volatile int        trptr;      // Next byte to transmit (advanced by interrupt)
+    volatile int        twptr;      // Next free space (advanced by uwrite)
+    int                 thigh;      // Most bytes ever held in transmit ring
+    int                 dmach;      // DMA channel for receive, or -1 if interrupt driven
+    uint32_t            ntotal;     // DMA: Total bytes received
+    uint32_t            nleft;      // DMA: Transfer count at the last update
+    uint32_t            rtotal;     // DMA: Total bytes read
+    uint32_t            nover;      // Bytes lost to overruns
+    uint32_t            nidle;      // DMA: Number of times the line has gone idle after receiving
+    bool                bBusy;      // DMA: Data received since the last tick
+    struct repeating_timer  dmatmr;
     } UDATA;
 
 UDATA udata[NUM_UARTS];
 
+#define UART_UARTIMSC_RX_BITS   ( UART_UARTIMSC_RXIM_BITS | UART_UARTIMSC_RTIM_BITS )
+
 static void uart_input (UDATA *pud)
     {
     critical_section_enter_blocking (&pud->ucs);
-    int wend = ( pud->rptr - 1 ) & ( NDATA - 1 );
+    int wend = ( pud->rptr - 1 ) & pud->rmask;
     while ((pud->wptr != wend) && (uart_is_readable (pud->uart)))
         {
         pud->data[pud->wptr] = uart_getc (pud->uart);
-        pud->wptr = (++pud->wptr) & ( NDATA - 1 );
+        pud->wptr = ( pud->wptr + 1 ) & pud->rmask;
+        }
+    int nused = ( pud->wptr - pud->rptr ) & pud->rmask;
+    if ( nused > pud->rhigh ) pud->rhigh = nused;
+    if ( ((uart_hw_t *)pud->uart)->rsr & UART_UARTRSR_OE_BITS )
+        {
+        ++pud->nover;
+        ((uart_hw_t *)pud->uart)->rsr = 0;
         }
     if ( pud->wptr == wend )
         {
         hw_clear_bits (&((uart_hw_t *)pud->uart)->cr, UART_UARTCR_RTS_BITS);
-        hw_clear_bits (&((uart_hw_t *)pud->uart)->imsc, UART_UARTIMSC_RXIM_BITS);
+        hw_clear_bits (&((uart_hw_t *)pud->uart)->imsc, UART_UARTIMSC_RX_BITS);
         }
     critical_section_exit (&pud->ucs);
     }
 
+// Move bytes from the transmit ring to the FIFO. The transmit interrupt is only
+// enabled while there is more to send:
+static void uart_output (UDATA *pud)
+    {
+    critical_section_enter_blocking (&pud->ucs);
+    int rptr = pud->trptr;
+    while (( rptr != pud->twptr ) && ( uart_is_writable (pud->uart) ))
+        {
+        uart_get_hw (pud->uart)->dr = pud->txdata[rptr];
+        rptr = ( rptr + 1 ) & pud->tmask;
+        }
+    pud->trptr = rptr;
+    if ( rptr == pud->twptr )
+        hw_clear_bits (&((uart_hw_t *)pud->uart)->imsc, UART_UARTIMSC_TXIM_BITS);
+    else
+        hw_set_bits (&((uart_hw_t *)pud->uart)->imsc, UART_UARTIMSC_TXIM_BITS);
+    critical_section_exit (&pud->ucs);
+    }
+
+/*  DMA receive: the channel writes continuously round the ring, which is aligned to its
+    length. Rather than pointers, running totals of bytes received and read are kept, with
+    ring positions being the totals modulo the ring length. That allows overruns (the DMA
+    lapping the reader) to be detected and counted. The total received is brought up to date
+    on each read and on a regular tick. The write address gives the position in the ring, and
+    the fall in the transfer count since the last update gives the number of whole laps, in
+    case the tick has been held off (e.g. by a flash write) for longer than the ring takes to
+    fill.
+*/
+#if PICO == 2
+#define DMA_NXFER   DMA_CH0_TRANS_COUNT_COUNT_BITS  // Transfers before the channel re-triggers itself
+#define DMA_COUNT   (( DMA_CH0_TRANS_COUNT_MODE_VALUE_TRIGGER_SELF << DMA_CH0_TRANS_COUNT_MODE_LSB ) | DMA_NXFER )
+#else
+#define DMA_NXFER   0xFFFFFFFF      // Several hours of data, then restarted by the tick
+#define DMA_COUNT   DMA_NXFER
+#endif
+
+static uint32_t udma_sync (UDATA *pud)
+    {
+    critical_section_enter_blocking (&pud->ucs);
+    uint32_t nleft = dma_hw->ch[pud->dmach].transfer_count & DMA_NXFER;
+    uint32_t wptr = ( dma_hw->ch[pud->dmach].write_addr - (uintptr_t) pud->data ) & pud->rmask;
+    uint32_t nnew = ( wptr - pud->ntotal ) & pud->rmask;
+    uint32_t ncount = pud->nleft - nleft;
+    if ( nleft > pud->nleft ) ncount += DMA_NXFER;  // Count reloaded
+    pud->nleft = nleft;
+    // Add any whole laps, allowing for the count and address being read at different times
+    if ( (int32_t) ( ncount - nnew ) > pud->rmask / 2 )
+        nnew += ( ncount - nnew + pud->rmask / 2 ) & ~ pud->rmask;
+    pud->ntotal += nnew;
+    uint32_t navail = pud->ntotal - pud->rtotal;
+    if ( navail > pud->rmask )
+        {
+        // Lapped: keep the most recent data, less a margin for bytes arriving during the copy
+        uint32_t nkeep = ( pud->rmask + 1 ) / 2;
+        pud->nover += navail - nkeep;
+        pud->rtotal = pud->ntotal - nkeep;
+        navail = nkeep;
+        }
+    if ( navail > (uint32_t) pud->rhigh ) pud->rhigh = navail;
+    uart_hw_t *puh = (uart_hw_t *) pud->uart;
+    if ( puh->rsr & UART_UARTRSR_OE_BITS )
+        {
+        ++pud->nover;
+        puh->rsr = 0;
+        }
+    critical_section_exit (&pud->ucs);
+    return nnew;
+    }
+
+static bool udma_tick (struct repeating_timer *prt)
+    {
+    UDATA *pud = (UDATA *) prt->user_data;
+    if ( udma_sync (pud) > 0 )
+        {
+        pud->bBusy = true;
+        }
+    else if ( pud->bBusy )
+        {
+        ++pud->nidle;
+        pud->bBusy = false;
+        }
+#if PICO != 2
+    if ( ! dma_channel_is_busy (pud->dmach) ) dma_channel_set_trans_count (pud->dmach, DMA_COUNT, true);
+#endif
+    return true;
+    }
+
+static bool udma_open (UDATA *pud)
+    {
+    pud->dmach = dma_claim_unused_channel (false);
+    if ( pud->dmach < 0 ) return false;
+    int nbit = 0;
+    while (( 1 << nbit ) <= pud->rmask ) ++nbit;
+    dma_channel_config c = dma_channel_get_default_config (pud->dmach);
+    channel_config_set_transfer_data_size (&c, DMA_SIZE_8);
+    channel_config_set_read_increment (&c, false);
+    channel_config_set_write_increment (&c, true);
+    channel_config_set_ring (&c, true, nbit);
+    channel_config_set_dreq (&c, uart_get_dreq (pud->uart, false));
+    pud->nleft = DMA_NXFER;
+    dma_channel_configure (pud->dmach, &c, pud->data, &uart_get_hw (pud->uart)->dr, DMA_COUNT, true);
+    hw_set_bits (&((uart_hw_t *)pud->uart)->dmacr, UART_UARTDMACR_RXDMAE_BITS);
+    add_repeating_timer_us (- DMA_TICK_US, udma_tick, pud, &pud->dmatmr);
+    return true;
+    }
+
+static void udma_close (UDATA *pud)
+    {
+    cancel_repeating_timer (&pud->dmatmr);
+    hw_clear_bits (&((uart_hw_t *)pud->uart)->dmacr, UART_UARTDMACR_RXDMAE_BITS);
+    dma_channel_abort (pud->dmach);
+    dma_channel_unclaim (pud->dmach);
+    pud->dmach = -1;
+    }
+
 static void irq_uart0 (void)
     {
-    uart_input (&udata[0]);
+    if ( udata[0].dmach < 0 ) uart_input (&udata[0]);
+    uart_output (&udata[0]);
     }
 
 static void irq_uart1 (void)
     {
-    uart_input (&udata[1]);
+    if ( udata[1].dmach < 0 ) uart_input (&udata[1]);
+    uart_output (&udata[1]);
+    }
+
+// Access received data in place (DMA mode). Returns the number of contiguous bytes available
+// at *pptr; call urxdone with the number used:
+int urxdata (int uid, char **pptr)
+    {
+    if (( uid < 0 ) || ( uid > 1 ) || ( udata[uid].dmach < 0 )) return 0;
+    UDATA *pud = &udata[uid];
+    udma_sync (pud);
+    uint32_t rptr = pud->rtotal & pud->rmask;
+    uint32_t navail = pud->ntotal - pud->rtotal;
+    if ( navail > pud->rmask + 1 - rptr ) navail = pud->rmask + 1 - rptr;
+    *pptr = pud->data + rptr;
+    return navail;
+    }
+
+void urxdone (int uid, int nbyte)
+    {
+    if (( uid < 0 ) || ( uid > 1 ) || ( udata[uid].dmach < 0 ) || ( nbyte <= 0 )) return;
+    UDATA *pud = &udata[uid];
+    critical_section_enter_blocking (&pud->ucs);
+    if ( (uint32_t) nbyte > pud->ntotal - pud->rtotal ) nbyte = pud->ntotal - pud->rtotal;
+    pud->rtotal += nbyte;
+    critical_section_exit (&pud->ucs);
+    }
+
+// Copy whole items directly from the DMA ring:
+static int udma_read (UDATA *pud, char *ptr, int size, int nmemb, int uid)
+    {
+    udma_sync (pud);
+    uint32_t navail = pud->ntotal - pud->rtotal;
+    if ( (uint32_t) nmemb > navail / size ) nmemb = navail / size;
+    int nbyte = size * nmemb;
+    while ( nbyte > 0 )
+        {
+        char *pdata;
+        int n = urxdata (uid, &pdata);
+        if ( n == 0 ) break;
+        if ( n > nbyte ) n = nbyte;
+        memcpy (ptr, pdata, n);
+        urxdone (uid, n);
+        ptr += n;
+        nbyte -= n;
+        }
+    return nmemb;
     }
 
 int uread (char *ptr, int size, int nmemb, int uid)
     {
     UDATA *pud = &udata[uid];
+    if ( pud->dmach >= 0 ) return udma_read (pud, ptr, size, nmemb, uid);
     int nread = 0;
     uart_input (pud);
     if ( size == 1 )
@@ -57,23 +254,23 @@ int uread (char *ptr, int size, int nmemb, int uid)
         while ((nmemb > 0) && (pud->rptr != pud->wptr))
             {
             *ptr = pud->data[pud->rptr];
-            pud->rptr = (++pud->rptr) & ( NDATA - 1 );
+            pud->rptr = ( pud->rptr + 1 ) & pud->rmask;
             ++ptr;
             ++nread;
             --nmemb;
             if ( pud->rptr == pud->wptr ) uart_input (pud);
             }
         }
-    else if ( size < NDATA )
+    else if ( size <= pud->rmask )
         {
         while (nmemb > 0)
             {
-            if (((pud->wptr - pud->rptr) & ( NDATA - 1 )) >= size )
+            if (((pud->wptr - pud->rptr) & pud->rmask) >= size )
                 {
                 for (int i = 0; i < size; ++i)
                     {
                     *ptr = pud->data[pud->rptr];
-                    pud->rptr = (++pud->rptr) & ( NDATA - 1 );
+                    pud->rptr = ( pud->rptr + 1 ) & pud->rmask;
                     ++ptr;
                     }
                 ++nread;
@@ -88,18 +285,68 @@ int uread (char *ptr, int size, int nmemb, int uid)
         }
     critical_section_enter_blocking (&pud->ucs);
     hw_set_bits (&((uart_hw_t *)pud->uart)->cr, UART_UARTCR_RTS_BITS);
-    hw_set_bits (&((uart_hw_t *)pud->uart)->imsc, UART_UARTIMSC_RXIM_BITS);
+    hw_set_bits (&((uart_hw_t *)pud->uart)->imsc, UART_UARTIMSC_RX_BITS);
     critical_section_exit (&pud->ucs);
     return nread;
     }
 
+// Queue data for transmission, only waiting if the transmit ring is full:
 int uwrite (const char *ptr, int size, int nmemb, int uid)
     {
     UDATA *pud = &udata[uid];
-    uart_write_blocking (pud->uart, ptr, size * nmemb);
+    int nbyte = size * nmemb;
+    while ( nbyte > 0 )
+        {
+        int wptr = pud->twptr;
+        int nfree = ( pud->trptr - wptr - 1 ) & pud->tmask;
+        if ( nfree > nbyte ) nfree = nbyte;
+        nbyte -= nfree;
+        while ( nfree > 0 )
+            {
+            pud->txdata[wptr] = *ptr;
+            wptr = ( wptr + 1 ) & pud->tmask;
+            ++ptr;
+            --nfree;
+            }
+        pud->twptr = wptr;
+        int nused = ( wptr - pud->trptr ) & pud->tmask;
+        if ( nused > pud->thigh ) pud->thigh = nused;
+        uart_output (pud);
+        }
     return nmemb;
     }
 
+// Most bytes held in the receive (bTx false) or transmit (bTx true) ring since the port was opened:
+int uhiwater (int uid, bool bTx)
+    {
+    if (( uid < 0 ) || ( uid > 1 )) return -1;
+    return bTx ? udata[uid].thigh : udata[uid].rhigh;
+    }
+
+// Number of received bytes lost because the buffer or UART FIFO overflowed:
+int uoverrun (int uid)
+    {
+    if (( uid < 0 ) || ( uid > 1 )) return -1;
+    return udata[uid].nover;
+    }
+
+// Number of times the line has gone idle after receiving data (DMA mode only):
+int uidle (int uid)
+    {
+    if (( uid < 0 ) || ( uid > 1 )) return -1;
+    return udata[uid].nidle;
+    }
+
+// Ring length: the requested size rounded up to a power of two, or the default:
+static int ringlen (int nreq, int ndef)
+    {
+    if ( nreq <= 0 ) return ndef;
+    if ( nreq > NMAXBUF ) nreq = NMAXBUF;
+    int nlen = 16;
+    while ( nlen < nreq ) nlen <<= 1;
+    return nlen;
+    }
+
 static bool uart_pin_valid (int uid, int func, int pin)
     {
     if (( pin < 0 ) || ( pin > 29 )) return false;
@@ -119,9 +366,37 @@ bool uopen (int uid, SERIAL_CONFIG *sc)
     {
     if (( uid < 0 ) || ( uid > 1 )) return false;
     UDATA *pud = &udata[uid];
+    // Already open: stop the interrupt, DMA and timer before the buffers are freed
+    if ( pud->data != NULL ) uclose (uid);
     pud->uart = uart_get_instance (uid);
+    bool bDMA = ( sc->dma > 0 );
+    int nrx = ringlen (sc->rxbuf, bDMA ? NDMABUF : NDATA);
+    if (( bDMA ) && ( nrx < NMINDMA )) nrx = NMINDMA;
+    int ntx = ringlen (sc->txbuf, NTXDATA);
+    pud->data = (char *) ( bDMA ? memalign (nrx, nrx) : malloc (nrx) );
+    pud->txdata = (char *) malloc (ntx);
+    if (( pud->data == NULL ) || ( pud->txdata == NULL ))
+        {
+        free (pud->data);
+        free (pud->txdata);
+        pud->data = NULL;
+        pud->txdata = NULL;
+        return false;
+        }
+    pud->rmask = nrx - 1;
+    pud->tmask = ntx - 1;
     pud->rptr = 0;
     pud->wptr = 0;
+    pud->rhigh = 0;
+    pud->trptr = 0;
+    pud->twptr = 0;
+    pud->thigh = 0;
+    pud->dmach = -1;
+    pud->ntotal = 0;
+    pud->rtotal = 0;
+    pud->nover = 0;
+    pud->nidle = 0;
+    pud->bBusy = false;
     critical_section_init (&pud->ucs);
     if ( uart_init (pud->uart, sc->baud) == 0 ) return false;
     if ( sc->tx >= 0 )
@@ -153,20 +428,40 @@ bool uopen (int uid, SERIAL_CONFIG *sc)
     else irq_set_exclusive_handler(UART1_IRQ, irq_uart1);
     hw_clear_bits (&((uart_hw_t *)pud->uart)->ifls, UART_UARTIFLS_RXIFLSEL_BITS);
     hw_set_bits (&((uart_hw_t *)pud->uart)->cr, UART_UARTCR_RTS_BITS);
-    hw_set_bits (&((uart_hw_t *)pud->uart)->imsc, UART_UARTIMSC_RXIM_BITS);
     if (( sc->data < 5 ) || ( sc->data > 8 )) return false;
     if (( sc->stop < 1 ) || ( sc->stop > 2 )) return false;
     int iPar;
     if (( sc->parity != UART_PARITY_NONE ) && ( sc->parity != UART_PARITY_EVEN )
         && ( sc->parity != UART_PARITY_ODD )) return false;
     uart_set_format (pud->uart, sc->data, sc->stop, sc->parity);
-    uart_set_irq_enables (pud->uart, true, false);
+    if ( bDMA )
+        {
+        // The FIFO is kept empty, so RTS is left to the hardware
+        if ( ! udma_open (pud) ) return false;
+        if ( sc->rts >= 0 ) uart_set_hw_flow (pud->uart, sc->cts >= 0, true);
+        uart_set_irq_enables (pud->uart, false, false);
+        }
+    else
+        {
+        uart_set_irq_enables (pud->uart, true, false);
+        }
+    irq_set_enabled (( uid == 0 ) ? UART0_IRQ : UART1_IRQ, true);
+    return true;
     }
 
 void uclose (int uid)
     {
     if (( uid < 0 ) || ( uid > 1 )) return;
     UDATA *pud = &udata[uid];
+    if ( pud->data == NULL ) return;    // Not open
+    while ( pud->trptr != pud->twptr ) uart_output (pud);
+    uart_tx_wait_blocking (pud->uart);
+    irq_set_enabled (( uid == 0 ) ? UART0_IRQ : UART1_IRQ, false);
+    if ( pud->dmach >= 0 ) udma_close (pud);
     uart_deinit (pud->uart);
     critical_section_deinit (&pud->ucs);
+    free (pud->data);
+    free (pud->txdata);
+    pud->data = NULL;
+    pud->txdata = NULL;
     }
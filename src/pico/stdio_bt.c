@@ -75,11 +75,52 @@ static int ncredit = NUM_BT_PKT;
 static void (*received_cb)(void *) = NULL;
 static void *cb_param = NULL;
 
-// Data to send
+// Data to send: held in a ring, and sent in packets of up to the channel's maximum frame size
+// each time RFCOMM can send
 
-static const char *psend = NULL;
-static int nsend = 0;
-static volatile bool bSent = false;
+#ifndef BT_TX_LEN
+#define BT_TX_LEN   1024                // Length of transmit ring (must be a power of 2)
+#endif
+#ifndef BT_TX_PKT
+#define BT_TX_PKT   512                 // Largest packet sent
+#endif
+
+static char txbuf[BT_TX_LEN];
+static volatile int trptr = 0;          // Next byte to send (advanced by packet handler)
+static volatile int twptr = 0;          // Next free byte (advanced by stdio)
+static volatile bool bPending = false;  // Can send now event requested
+static uint8_t txpkt[BT_TX_PKT];
+static int txmax = BT_PKT_LEN;          // Packet size for current channel
+static uint32_t nbytes = 0;             // Bytes sent
+static uint32_t npkts = 0;              // Packets sent
+static uint32_t nwaits = 0;             // Times output waited for space
+
+// Send as much queued data as will fit in one packet:
+static void send_data (void)
+    {
+    int rptr = trptr;
+    int nsend = ( twptr - rptr ) & ( BT_TX_LEN - 1 );
+    if ( nsend > txmax ) nsend = txmax;
+    if ( nsend == 0 )
+        {
+        // Output publishes twptr before testing bPending, so will request again for any new data
+        bPending = false;
+        return;
+        }
+    for (int i = 0; i < nsend; ++i)
+        {
+        txpkt[i] = txbuf[rptr];
+        rptr = ( rptr + 1 ) & ( BT_TX_LEN - 1 );
+        }
+    if ( rfcomm_send (rfcomm_channel_id, txpkt, (uint16_t) nsend) == 0 )
+        {
+        trptr = rptr;
+        nbytes += nsend;
+        ++npkts;
+        }
+    if ( twptr != trptr ) rfcomm_request_can_send_now_event (rfcomm_channel_id);
+    else bPending = false;
+    }
 
 static void add_credit (void)
     {
@@ -229,23 +270,19 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
                         {
                         rfcomm_channel_id = rfcomm_event_channel_opened_get_rfcomm_cid(packet);
                         mtu = rfcomm_event_channel_opened_get_max_frame_size(packet);
+                        txmax = ( mtu < BT_TX_PKT ) ? mtu : BT_TX_PKT;
                         // printf("RFCOMM channel open succeeded. New RFCOMM Channel ID %u, max frame size %u\n", rfcomm_channel_id, mtu);
                         }
                     break;
                 case RFCOMM_EVENT_CAN_SEND_NOW:
-                    if ( rfcomm_send(rfcomm_channel_id, (uint8_t*) psend, (uint16_t) nsend) == 0 )
-                        {
-                        bSent = true;
-                        }
-                    else
-                        {
-                        rfcomm_request_can_send_now_event (rfcomm_channel_id);
-                        }
+                    send_data ();
                     break;
 
                 case RFCOMM_EVENT_CHANNEL_CLOSED:
                     // printf("RFCOMM channel closed\n");
                     rfcomm_channel_id = 0;
+                    trptr = twptr;
+                    bPending = false;
                     break;
                 
                 default:
@@ -300,14 +337,41 @@ void stdio_bt_init (void)
     hci_power_control(HCI_POWER_ON);
     }
 
+// Queue output, only waiting if the ring is full:
 static void stdio_bt_out_chars (const char *buf, int len)
     {
-    if ( rfcomm_channel_id == 0 ) return;
-    bSent = false;
-    psend = buf;
-    nsend = len;
-    rfcomm_request_can_send_now_event (rfcomm_channel_id);
-    while ( ! bSent )
+    while (( len > 0 ) && ( rfcomm_channel_id != 0 ))
+        {
+        int wptr = twptr;
+        int nfree = ( trptr - wptr - 1 ) & ( BT_TX_LEN - 1 );
+        if ( nfree == 0 )
+            {
+            ++nwaits;
+            __wfi ();
+            continue;
+            }
+        if ( nfree > len ) nfree = len;
+        len -= nfree;
+        while ( nfree > 0 )
+            {
+            txbuf[wptr] = *buf;
+            wptr = ( wptr + 1 ) & ( BT_TX_LEN - 1 );
+            ++buf;
+            --nfree;
+            }
+        twptr = wptr;
+        if ( ! bPending )
+            {
+            bPending = true;
+            rfcomm_request_can_send_now_event (rfcomm_channel_id);
+            }
+        }
+    }
+
+// Wait until all queued output has been sent:
+static void stdio_bt_out_flush (void)
+    {
+    while (( rfcomm_channel_id != 0 ) && ( trptr != twptr ))
         {
         __wfi ();
         }
@@ -341,6 +405,7 @@ static void stdio_bt_set_chars_available_callback(void (*fn)(void*), void *param
 
 stdio_driver_t stdio_bt = {
     .out_chars = stdio_bt_out_chars,
+    .out_flush = stdio_bt_out_flush,
     .in_chars = stdio_bt_in_chars,
     .set_chars_available_callback = stdio_bt_set_chars_available_callback,
 #if PICO_STDIO_ENABLE_CRLF_SUPPORT
@@ -352,3 +417,10 @@ bool stdio_bt_connected (void)
     {
     return rfcomm_channel_id > 0;
     };
+
+void stdio_bt_stats (uint32_t *pnbytes, uint32_t *pnpkts, uint32_t *pnwaits)
+    {
+    *pnbytes = nbytes;
+    *pnpkts = npkts;
+    *pnwaits = nwaits;
+    }
@@ -42,6 +42,7 @@ static uint16_t renderbuf[256 * 8] __attribute((__aligned__(4)));
 static MODE curmode;
 static uint8_t  *framebuf = NULL;
 static volatile uint8_t  *displaybuf = NULL;
+static volatile int yorg = 0;           // Framebuffer row displayed at top of screen
 static uint32_t nFrame = 0;
 
 static uint16_t curpal[16];             // Current palette
@@ -137,17 +138,129 @@ extern const scanvideo_timing_t vga_timing_800x600_60_default;
 #endif
 #define FLASH_BIT   0x20    // Bit in frame count used to control flash
 
+/*  Teletext rows decoded to the attributes of each character cell, so that the control
+    codes are only interpreted again when a row is written (vga_out7), rather than on
+    every scan line. Each cell holds the offset of its glyph in the font, the foreground
+    and background colours, and flags for flashing and double height text. Held
+    graphics are resolved by copying the previous cell.
+*/
+#define TTX_ROWS    25                      // Rows in mode 7
+#define TTX_COLS    40                      // Columns in mode 7
+#define TTC_GLYPH   0x0000FFFF              // Offset of glyph in font
+#define TTC_FG      16                      // Shift for foreground colour
+#define TTC_FLASH   0x00080000              // Flashing text
+#define TTC_BG      20                      // Shift for background colour
+#define TTC_DBL     0x00800000              // Double height text
+#define TTC_BLANK   ( 0x20 * TTH )          // Offset of space glyph
+
+static uint32_t ttxcell[TTX_ROWS][TTX_COLS];    // Decoded character cells
+static bool ttxdbl[TTX_ROWS];                   // Row contains double height
+static volatile bool ttxdirty[TTX_ROWS];        // Row has to be decoded again
+
+static void __time_critical_func(ttx_alldirty) (void)
+    {
+    for (int iRow = 0; iRow < TTX_ROWS; ++iRow) ttxdirty[iRow] = true;
+    }
+
+static void __time_critical_func(ttx_decode) (int iRow)
+    {
+    const uint8_t *pch = &framebuf[iRow * curmode.tcol];
+    uint32_t *pcell = ttxcell[iRow];
+    uint32_t font = 0;
+    uint32_t nfg = 7;
+    uint32_t nbg = 0;
+    uint32_t cell = TTC_BLANK;
+    bool bFlash = false;
+    bool bDouble = false;
+    bool bGraph = false;
+    bool bCont = true;
+    bool bHold = false;
+    ttxdbl[iRow] = false;
+    for (int iCol = 0; iCol < curmode.tcol; ++iCol)
+        {
+        uint8_t ch = *pch & 0x7F;
+        if ( ch >= 0x20 )
+            {
+            cell = ( font + TTH * ch ) | ( nfg << TTC_FG ) | ( nbg << TTC_BG );
+            if ( bFlash ) cell |= TTC_FLASH;
+            if ( bDouble ) cell |= TTC_DBL;
+            }
+        else
+            {
+            if ( ! bHold ) cell = TTC_BLANK | ( nbg << TTC_BG );
+            if ((ch >= 0x00) && (ch <= 0x07))
+                {
+                font = 0;
+                bGraph = false;
+                nfg = ch & 0x07;
+                }
+            else if (ch == 0x08)
+                {
+                bFlash = true;
+                }
+            else if (ch == 0x09)
+                {
+                bFlash = false;
+                }
+            else if (ch == 0x0C)
+                {
+                bDouble = false;
+                }
+            else if (ch == 0x0D)
+                {
+                bDouble = true;
+                ttxdbl[iRow] = true;
+                }
+            else if ((ch >= 0x10) && (ch <= 0x17))
+                {
+                if ( bCont )    font = 0x60 * TTH;
+                else            font = 0xC0 * TTH;
+                bGraph = true;
+                nfg = ch & 0x07;
+                }
+            else if (ch == 0x19)
+                {
+                bCont = true;
+                if ( bGraph ) font = 0x60 * TTH;
+                }
+            else if (ch == 0x1A)
+                {
+                bCont = false;
+                if ( bGraph ) font = 0xC0 * TTH;
+                }
+            else if (ch == 0x1C)
+                {
+                nbg = 0;
+                }
+            else if (ch == 0x1D)
+                {
+                nbg = nfg;
+                }
+            else if (ch == 0x1E)
+                {
+                bHold = true;
+                }
+            else if (ch == 0x1F)
+                {
+                bHold = false;
+                }
+            }
+        pcell[iCol] = cell;
+        ++pch;
+        }
+    }
+
 void __time_critical_func(render_mode7) (void)
     {
     uint32_t iRow;
     uint32_t iScanCnt;
     uint32_t iScanLst;
-    bool bDouble = false;
     bool bLower = false;
     uint8_t *pttfont = &framebuf[curmode.trow * curmode.tcol] - 0x20 * TTH;
 #if DEBUG & 1
     printf ("Entered mode 7 rendering\n");
 #endif
+    ttx_alldirty ();
     while (curmode.ncbt == 3)
         {
 #if USE_INTERP
@@ -167,7 +280,9 @@ void __time_critical_func(render_mode7) (void)
         if ( displaybuf && ( iScan == 0 ))
             {
             framebuf = (uint8_t *) displaybuf;
-            displaybuf = NULL;;
+            displaybuf = NULL;
+            pttfont = &framebuf[curmode.trow * curmode.tcol] - 0x20 * TTH;
+            ttx_alldirty ();
             }
 #endif
         iScan -= curmode.vmgn;
@@ -185,7 +300,6 @@ void __time_critical_func(render_mode7) (void)
                 iRow = 0;
                 iScanCnt = 0;
                 iScanLst = 0;
-                bDouble = false;
                 bLower = false;
                 }
             else
@@ -194,154 +308,57 @@ void __time_critical_func(render_mode7) (void)
                 if ( iScanCnt >= ( curmode.thgt << curmode.yshf ) )
                     {
                     iScanCnt -= curmode.thgt << curmode.yshf;
-                    ++iRow;
-                    if (bDouble) bLower = ! bLower;
+                    if ( ttxdbl[iRow] ) bLower = ! bLower;
                     else bLower = false;
-                    bDouble = false;
+                    ++iRow;
                     }
                 iScanLst = iScan;
                 }
             iScan = iScanCnt >> curmode.yshf;
-            uint8_t *pch = &framebuf[iRow * curmode.tcol];
+            if ( ttxdirty[iRow] )
+                {
+                ttxdirty[iRow] = false;
+                ttx_decode (iRow);
+                }
+            const uint32_t *pcell = ttxcell[iRow];
+            const uint32_t *pal = (const uint32_t *) renderbuf;
             uint32_t *pxline = twopix;
-            const uint8_t *pfont = pttfont;
-            int nfg = 7;
-            uint32_t bgnd = ((uint32_t *)renderbuf)[0];
-            uint32_t fgnd = ((uint32_t *)renderbuf)[nfg];
-            bool bFlash = false;
-            bool bGraph = false;
-            bool bCont = true;
-            bool bHold = false;
-            int iScan2 = iScan;
+            bool bFlashOff = (( nFrame & FLASH_BIT ) != 0 );
+            int iScan2;
+            if ( bLower )   iScan2 = ( iScan + TTH ) >> 1;
+            else            iScan2 = iScan >> 1;
             ++twopix;
             for (int iCol = 0; iCol < curmode.tcol; ++iCol)
                 {
-                uint8_t ch = *pch & 0x7F;
-                if ( ch >= 0x20 )
-                    {
-                    uint8_t px = pfont[TTH * ch + iScan2];
-                    ++twopix;
-                    if ( px & 0x01 ) *twopix = fgnd;
-                    else             *twopix = bgnd;
-                    ++twopix;
-                    if ( px & 0x02 ) *twopix = fgnd;
-                    else             *twopix = bgnd;
-                    ++twopix;
-                    if ( px & 0x04 ) *twopix = fgnd;
-                    else             *twopix = bgnd;
-                    ++twopix;
-                    if ( px & 0x08 ) *twopix = fgnd;
-                    else             *twopix = bgnd;
-                    ++twopix;
-                    if ( px & 0x10 ) *twopix = fgnd;
-                    else             *twopix = bgnd;
-                    ++twopix;
-                    if ( px & 0x20 ) *twopix = fgnd;
-                    else             *twopix = bgnd;
-                    ++twopix;
-                    if ( px & 0x40 ) *twopix = fgnd;
-                    else             *twopix = bgnd;
-                    ++twopix;
-                    if ( px & 0x80 ) *twopix = fgnd;
-                    else             *twopix = bgnd;
-                    }
-                else
-                    {
-                    if ( bHold )
-                        {
-                        twopix[0] = twopix[-8];
-                        twopix[1] = twopix[-7];
-                        twopix[2] = twopix[-6];
-                        twopix[3] = twopix[-5];
-                        twopix[4] = twopix[-4];
-                        twopix[5] = twopix[-3];
-                        twopix[6] = twopix[-2];
-                        twopix[7] = twopix[-1];
-                        }
-                    else
-                        {
-                        twopix[0] = bgnd;
-                        twopix[1] = bgnd;
-                        twopix[2] = bgnd;
-                        twopix[3] = bgnd;
-                        twopix[4] = bgnd;
-                        twopix[5] = bgnd;
-                        twopix[6] = bgnd;
-                        twopix[7] = bgnd;
-                        }
-                    twopix += 8;
-                    if ((ch >= 0x00) && (ch <= 0x07))
-                        {
-                        pfont = pttfont;
-                        bGraph = false;
-                        nfg = ch & 0x07;
-                        if (( bFlash ) && ( nFrame & FLASH_BIT ))
-                            fgnd = bgnd;
-                        else
-                            fgnd = ((uint32_t *)renderbuf)[nfg];
-                        }
-                    else if (ch == 0x08)
-                        {
-                        bFlash = true;
-                        if ( nFrame & FLASH_BIT )
-                            fgnd = bgnd;
-                        else
-                            fgnd = ((uint32_t *)renderbuf)[nfg];
-                        }
-                    else if (ch == 0x09)
-                        {
-                        bFlash = false;
-                        fgnd = ((uint32_t *)renderbuf)[nfg];
-                        }
-                    else if (ch == 0x0C)
-                        {
-                        iScan2 = iScan;
-                        }
-                    else if (ch == 0x0D)
-                        {
-                        if ( bLower )   iScan2 = ( iScan + TTH ) >> 1;
-                        else            iScan2 = iScan >> 1;
-                        bDouble = true;
-                        }
-                    else if ((ch >= 0x10) && (ch <= 0x17))
-                        {
-                        if ( bCont )    pfont = pttfont + 0x60 * TTH;
-                        else            pfont = pttfont + 0xC0 * TTH;
-                        bGraph = true;
-                        nfg = ch & 0x07;
-                        if (( bFlash ) && ( nFrame & FLASH_BIT ))
-                            fgnd = bgnd;
-                        else
-                            fgnd = ((uint32_t *)renderbuf)[nfg];
-                        }
-                    else if (ch == 0x19)
-                        {
-                        bCont = true;
-                        if ( bGraph ) pfont = pttfont + 0x60 * TTH;
-                        }
-                    else if (ch == 0x1A)
-                        {
-                        bCont = false;
-                        if ( bGraph ) pfont = pttfont + 0xC0 * TTH;
-                        }
-                    else if (ch == 0x1C)
-                        {
-                        bgnd = ((uint32_t *)renderbuf)[0];
-                        }
-                    else if (ch == 0x1D)
-                        {
-                        bgnd = ((uint32_t *)renderbuf)[nfg];
-                        }
-                    else if (ch == 0x1E)
-                        {
-                        bHold = true;
-                        }
-                    else if (ch == 0x1F)
-                        {
-                        bHold = false;
-                        }
-                    }
-                ++pch;
+                uint32_t cell = pcell[iCol];
+                uint32_t bgnd = pal[( cell >> TTC_BG ) & 0x07];
+                uint32_t fgnd = pal[( cell >> TTC_FG ) & 0x07];
+                if (( cell & TTC_FLASH ) && bFlashOff ) fgnd = bgnd;
+                uint8_t px = pttfont[( cell & TTC_GLYPH ) + (( cell & TTC_DBL ) ? iScan2 : iScan )];
+                ++twopix;
+                if ( px & 0x01 ) *twopix = fgnd;
+                else             *twopix = bgnd;
+                ++twopix;
+                if ( px & 0x02 ) *twopix = fgnd;
+                else             *twopix = bgnd;
+                ++twopix;
+                if ( px & 0x04 ) *twopix = fgnd;
+                else             *twopix = bgnd;
+                ++twopix;
+                if ( px & 0x08 ) *twopix = fgnd;
+                else             *twopix = bgnd;
+                ++twopix;
+                if ( px & 0x10 ) *twopix = fgnd;
+                else             *twopix = bgnd;
+                ++twopix;
+                if ( px & 0x20 ) *twopix = fgnd;
+                else             *twopix = bgnd;
+                ++twopix;
+                if ( px & 0x40 ) *twopix = fgnd;
+                else             *twopix = bgnd;
+                ++twopix;
+                if ( px & 0x80 ) *twopix = fgnd;
+                else             *twopix = bgnd;
                 }
             ++twopix;
             *twopix = COMPOSABLE_EOL_ALIGN << 16;   // Implicit zero (black) in low word
@@ -493,7 +510,9 @@ void __time_critical_func(render_loop) (void)
                 }
             uint32_t *pxline = twopix;
             twopix += 2;
-            uint8_t *pfb = framebuf + iScan * curmode.nbpl;
+            int iLine = iScan + yorg;
+            if ( iLine >= curmode.grow ) iLine -= curmode.grow;
+            uint8_t *pfb = framebuf + iLine * curmode.nbpl;
             if ( curmode.nppb == 8 )
                 {
 #if USE_INTERP
@@ -659,6 +678,18 @@ void gsize (uint32_t *pwth, uint32_t *phgt)
     *phgt = 480;
     }
 
+// Set the framebuffer row displayed at the top of the screen (for scrolling):
+void vga_roll (int yp)
+    {
+    yorg = yp;
+    }
+
+// Teletext rows yp1 to yp2 have been written:
+void vga_out7 (uint8_t *fbuf, int xp1, int yp1, int xp2, int yp2)
+    {
+    for (int iRow = yp1; ( iRow <= yp2 ) && ( iRow < TTX_ROWS ); ++iRow) ttxdirty[iRow] = true;
+    }
+
 void bufswap (uint8_t *fbuf)
     {
     displaybuf = fbuf;
@@ -786,7 +817,11 @@ const MODE * setmode (int mode)
         bBlank = true;
         memcpy (&curmode, &modes[mode], sizeof (MODE));
         framebuf = singlebuf ();
-        if ( curmode.ncbt == 3 ) memcpy (&framebuf[curmode.trow * curmode.tcol], font_tt, sizeof (font_tt));
+        if ( curmode.ncbt == 3 )
+            {
+            memcpy (&framebuf[curmode.trow * curmode.tcol], font_tt, sizeof (font_tt));
+            ttx_alldirty ();
+            }
         fbmode (framebuf, &curmode);
         return &curmode;
         }
@@ -1,11 +1,32 @@
-/* picokbd.c - Local USB keyboard handling */
+/* picokbd.c - Local USB keyboard handling
+
+    Boot protocol (6 key) and report protocol N-key rollover keyboard reports are
+    both converted to a bitmap of the keys down, indexed by HID usage. Changes from
+    the previous bitmap generate key presses and releases, each recorded with its
+    time in a queue which may be read by kbd_event. The bitmap is only written from
+    the USB task, so INKEY with a negative argument reads it without locking.
+    Auto-repeat is generated by an alarm for the last key pressed.
+*/
 
 #include "pico.h"
 #include "pico/stdlib.h"
 #include "bsp/board.h"
 #include "periodic.h"
+#include "spscq.h"
 #include "tusb.h"
 #include <stdio.h>
+#include <string.h>
+
+#ifndef KBD_RPT_DELAY
+#define KBD_RPT_DELAY   500             // Time before auto-repeat starts (ms)
+#endif
+#ifndef KBD_RPT_PERIOD
+#define KBD_RPT_PERIOD  50              // Auto-repeat interval (ms)
+#endif
+#ifndef KBD_EVT_LEN
+#define KBD_EVT_LEN     32              // Length of key event queue (must be a power of 2)
+#endif
+#define NKRO_MIN_LEN    ( 1 + ( HID_KEY_APPLICATION + 8 ) / 8 ) // Modifiers and bitmap to usage 0x65
 
 #if PICO_SDK_VERSION_MAJOR == 1
 #if PICO_SDK_VERSION_MINOR < 2
@@ -45,8 +66,23 @@ uint8_t kbd_inst;
 // Defined in bbccon.c
 extern int putkey (char key);
 
+typedef struct
+    {
+    uint32_t time;                      // Time of transition (microseconds)
+    uint8_t  key;                       // HID usage
+    uint8_t  down;                      // 1 = pressed, 0 = released
+    uint16_t spare;
+    } KBD_EVENT;
+
 static bool bRepeat;
 static uint8_t led_flags = 0;
+static volatile uint32_t keybits[8];    // Keys down, by HID usage
+static volatile uint8_t kbd_mods = 0;   // Current modifiers
+static KBD_EVENT kbd_evbuf[KBD_EVT_LEN];
+static SPSCQ kbd_evq = SPSCQ_INIT (kbd_evbuf, KBD_EVT_LEN, sizeof (KBD_EVENT));
+static alarm_id_t rpt_alarm = 0;
+static uint8_t rpt_key;                 // HID usage of key repeating
+static uint8_t rpt_code;                // Character it generates
 
 void set_leds (uint8_t leds)
     {
@@ -160,18 +196,37 @@ static const KEYMAP padmap[] =
     { 135, '.'}    // 0x63 HID_KEY_KEYPAD_DECIMAL
     };
 
-static uint8_t keydn[HID_KEY_F20 + 1];
-static hid_keyboard_report_t prev_report = {0, 0, {0}}; // previous report to check key released
-
 bool bPrtScrn = false;
 
-static void key_press (uint8_t modifier, uint8_t key)
+static inline bool key_isdown (uint8_t key)
+    {
+    return ( keybits[key >> 5] >> ( key & 0x1F ) ) & 1;
+    }
+
+static int64_t key_repeat (alarm_id_t id, void *user_data)
+    {
+    if ( ! key_isdown (rpt_key) )
+        {
+        rpt_alarm = 0;
+        return 0;
+        }
+    putkey (rpt_code);
+    return 1000 * KBD_RPT_PERIOD;
+    }
+
+static void repeat_stop (void)
+    {
+    if ( rpt_alarm > 0 ) cancel_alarm (rpt_alarm);
+    rpt_alarm = 0;
+    }
+
+// Returns the character generated, if any:
+static uint8_t key_press (uint8_t modifier, uint8_t key)
     {
 #if DEBUG > 0
     printf ("key_press (0x%02X)\n", key);
 #endif
     uint8_t leds = led_flags;
-    if ( key <= HID_KEY_F20 ) keydn[key] = 1;
     if ( key < HID_KEY_A )
         {
         key = 0;
@@ -286,7 +341,7 @@ static void key_press (uint8_t modifier, uint8_t key)
         if ( modifier & ( KEYBOARD_MODIFIER_LEFTGUI | KEYBOARD_MODIFIER_RIGHTGUI ))
             key ^= 23;
         }
-    if ( key > 0 ) putkey (key);
+    return key;
     }
 
 static void key_release (uint8_t key)
@@ -294,51 +349,104 @@ static void key_release (uint8_t key)
 #if DEBUG > 0
     printf ("key_release (0x%02X)\n", key);
 #endif
-    if ( key <= HID_KEY_F20 ) keydn[key] = 0;
+    if ( key == rpt_key ) repeat_stop ();
     }
 
-// look up new key in previous keys
-static inline int find_key_in_report(hid_keyboard_report_t const *p_report, uint8_t keycode)
+// Act on the differences between the new bitmap of keys down and the current one:
+static void process_keys (uint8_t modifier, const uint32_t *pnew)
     {
-    for (int i = 0; i < 6; i++)
+    uint32_t t = time_us_32 ();
+    kbd_mods = modifier;
+    for (int i = 0; i < 8; ++i)
         {
-        if (p_report->keycode[i] == keycode) return i;
+        uint32_t chg = pnew[i] ^ keybits[i];
+        while ( chg )
+            {
+            int b = __builtin_ctz (chg);
+            uint32_t bit = 1u << b;
+            KBD_EVENT evt = { t, 32 * i + b, 0, 0 };
+            chg &= ~ bit;
+            bRepeat = true;
+            if ( pnew[i] & bit )
+                {
+                keybits[i] |= bit;
+                evt.down = 1;
+                spscq_put (&kbd_evq, &evt);
+                uint8_t code = key_press (modifier, evt.key);
+                if ( code > 0 )
+                    {
+                    putkey (code);
+                    repeat_stop ();
+                    rpt_key = evt.key;
+                    rpt_code = code;
+                    rpt_alarm = add_alarm_in_ms (KBD_RPT_DELAY, key_repeat, NULL, false);
+                    }
+                }
+            else
+                {
+                keybits[i] &= ~ bit;
+                spscq_put (&kbd_evq, &evt);
+                key_release (evt.key);
+                }
+            }
         }
-    return -1;
     }
 
+// Boot protocol report, up to 6 keys:
 static inline void process_kbd_report(hid_keyboard_report_t const *p_new_report)
     {
+    uint32_t newbits[8] = { 0 };
     for (int i = 0; i < 6; ++i)
         {
         uint8_t key = p_new_report->keycode[i];
-        if ( key )
-            {
 #if DEBUG > 0
-            printf ("Key %d reported.\n", key);
+        if ( key ) printf ("Key %d reported.\n", key);
 #endif
-            int kp = find_key_in_report(&prev_report, key);
-            if ( kp < 0 )
-                {
-                key_press (p_new_report->modifier, key);
-                bRepeat = true;
-                }
-            else
-                {
-                prev_report.keycode[kp] = 0;
-                }
-            }
+        if ( key == 0x01 ) return;      // ErrorRollOver, keep last state
+        if ( key >= HID_KEY_A ) newbits[key >> 5] |= 1u << ( key & 0x1F );
         }
-    for (int i = 0; i < 6; ++i)
+    newbits[HID_KEY_CONTROL_LEFT >> 5] |= p_new_report->modifier;
+    process_keys (p_new_report->modifier, newbits);
+    }
+
+// Report protocol keyboard report. The layout is judged from the length: one of at least
+// NKRO_MIN_LEN bytes is the modifiers followed by a bitmap of keys from usage 0, one of up
+// to 8 bytes is laid out as a boot protocol report, and any other is ignored:
+static void process_nkro_report (uint8_t const *report, uint16_t len)
+    {
+    uint32_t newbits[8] = { 0 };
+    if ( len < NKRO_MIN_LEN )
         {
-        uint8_t key = prev_report.keycode[i];
-        if ( key )
+        if (( len > 0 ) && ( len <= sizeof (hid_keyboard_report_t) ))
             {
-            key_release (key);
-            bRepeat = true;
+            hid_keyboard_report_t boot;
+            memset (&boot, 0, sizeof (boot));
+            memcpy (&boot, report, len);
+            process_kbd_report (&boot);
             }
+        return;
         }
-    prev_report = *p_new_report;
+    uint8_t modifier = report[0];
+    ++report;
+    --len;
+    if ( len > HID_KEY_CONTROL_LEFT / 8 ) len = HID_KEY_CONTROL_LEFT / 8;
+    for (int i = 0; i < len; ++i)
+        newbits[i >> 2] |= ((uint32_t) report[i]) << ( 8 * ( i & 3 ));
+    newbits[0] &= ~ 0x0F;    // Usages 0 to 3 are not keys
+    newbits[HID_KEY_CONTROL_LEFT >> 5] |= modifier;
+    process_keys (modifier, newbits);
+    }
+
+// Next timestamped key transition, false if none:
+bool kbd_event (KBD_EVENT *pevt)
+    {
+    return spscq_get (&kbd_evq, pevt);
+    }
+
+// Number of key transitions lost because the queue was full:
+int kbd_event_drops (void)
+    {
+    return kbd_evq.ndrop;
     }
 
 #if KBD_VERSION == 1
@@ -578,6 +686,37 @@ void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t cons
 #endif
         process_kbd_report( (hid_keyboard_report_t const*) report );
         }
+    else if (itf_protocol == HID_ITF_PROTOCOL_NONE)
+        {
+        // Look for an N-key rollover keyboard report
+        uint8_t const rpt_count = hid_info[instance].report_count;
+        tuh_hid_report_info_t* rpt_info = NULL;
+        if ( rpt_count == 1 && hid_info[instance].report_info[0].report_id == 0 )
+            {
+            rpt_info = &hid_info[instance].report_info[0];
+            }
+        else if ( len > 0 )
+            {
+            for (uint8_t i = 0; i < rpt_count; i++)
+                {
+                if ( report[0] == hid_info[instance].report_info[i].report_id )
+                    {
+                    rpt_info = &hid_info[instance].report_info[i];
+                    break;
+                    }
+                }
+            report++;
+            len--;
+            }
+        if (( rpt_info != NULL ) && ( rpt_info->usage_page == HID_USAGE_PAGE_DESKTOP )
+            && ( rpt_info->usage == HID_USAGE_DESKTOP_KEYBOARD ))
+            {
+#if DEBUG > 1
+            printf("HID receive NKRO keyboard report\r\n");
+#endif
+            process_nkro_report (report, len);
+            }
+        }
 
     // continue to request to receive report
     if ( !tuh_hid_receive_report(dev_addr, instance) )
@@ -591,8 +730,6 @@ void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t cons
 #error Unknown TinyUSB Version
 #endif  // KBD_VERSION
 
-static PRD_FUNC pnext = NULL;
-
 static void keyboard_periodic (void)
     {
 #if DEBUG == 2
@@ -605,7 +742,6 @@ static void keyboard_periodic (void)
         tuh_task();
         hid_task();
         }
-    if (pnext) pnext ();
     }
 
 void setup_keyboard (void)
@@ -613,9 +749,9 @@ void setup_keyboard (void)
 #if DEBUG > 0
     printf ("setup_keyboard " __DATE__ " " __TIME__ "\n");
 #endif
-    memset (keydn, 0, sizeof (keydn));
+    memset ((void *) keybits, 0, sizeof (keybits));
     tusb_init();
-    pnext = add_periodic (keyboard_periodic);
+    add_periodic (keyboard_periodic, 2, 0);
     }
 
 #define HID_KEY_CONTROL_ALL 0xE8
@@ -781,13 +917,13 @@ int testkey (int key)
     if ( key >= HID_KEY_CONTROL_LEFT )
         {
 #if DEBUG == 2
-        printf ("Modifiers = 0x%02X\n", prev_report.modifier);
+        printf ("Modifiers = 0x%02X\n", kbd_mods);
 #endif
-        key = ( prev_report.modifier & modmsk[key - HID_KEY_CONTROL_LEFT] ) ? -1 : 0;
+        key = ( kbd_mods & modmsk[key - HID_KEY_CONTROL_LEFT] ) ? -1 : 0;
         }
     else if ( key > 0 )
         {
-        key = - keydn[key];
+        key = key_isdown (key) ? -1 : 0;
         }
 #if DEBUG == 2
     printf ("Result = %d\n", key);
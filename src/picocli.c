@@ -15,6 +15,15 @@
 #if ( defined(STDIO_USB) || defined(STDIO_UART) )
 bool bBBCtl = false;
 #endif
+#ifdef VAR_CACHE
+#include "varcache.h"
+#endif
+#ifdef PROFILE
+#include "profile.h"
+#ifndef MAX_PATH
+#define MAX_PATH 260
+#endif
+#endif
 #ifdef PICO_GRAPH
 void graphvdu (int code, int data1, int data2);
 #endif
@@ -24,11 +33,19 @@ void refresh (const char *p);
 #define MAX_PATH 260
 int sdump (FILE *fBmp);
 int sload (FILE *fBmp);
+int sdumprle (FILE *fRle);
+int sloadrle (FILE *fRle);
+bool srle_ext (const char *path);
 #endif
 
 void error (int, const char *);
+void text (const char *);
+void crlf (void);
 char *setup (char *dst, const char *src, char *ext, char term, unsigned char *pflag);
 extern int vpage;
+#ifdef VDU_CORE1
+void vdufence (void);
+#endif
 
 void os_LINENO (const char *);
 #if defined(PICO_GUI) || defined(PICO_GRAPH)
@@ -37,10 +54,16 @@ void os_DISPLAY (const char *);
 #if ( defined(STDIO_USB) || defined(STDIO_UART) )
 void os_OUTPUT (const char *);
 #endif
+#ifdef PROFILE
+void os_PROFILE (const char *);
+#endif
 #if defined(PICO_GUI) || defined(PICO_GRAPH)
 void os_REFRESH (const char *);
 void os_SCREENSAVE (const char *);
 #endif
+#ifdef VAR_CACHE
+void os_VCACHE (const char *);
+#endif
 #if HAVE_MODEM
 void os_XDOWNLOAD (const char *);
 void os_XUPLOAD (const char *);
@@ -61,9 +84,15 @@ static char *cmds[] = {
 #if ( defined(STDIO_USB) || defined(STDIO_UART) )
     "output",
 #endif
+#ifdef PROFILE
+    "profile",
+#endif
 #if defined(PICO_GUI) || defined(PICO_GRAPH)
     "refresh", "screensave",
 #endif
+#ifdef VAR_CACHE
+    "vcache",
+#endif
 #if HAVE_MODEM
     "xdownload", "xupload", "ydownload", "yupload", "zdownload", "zupload"
 #endif
@@ -79,10 +108,16 @@ static void (*os_funcs[])(const char *) =
 #if ( defined(STDIO_USB) || defined(STDIO_UART) )
     os_OUTPUT,      // OUTPUT
 #endif
+#ifdef PROFILE
+    os_PROFILE,     // PROFILE
+#endif
 #if defined(PICO_GUI) || defined(PICO_GRAPH)
     os_REFRESH,     // REFRESH
     os_SCREENSAVE,  // SCREENSAVE
 #endif
+#ifdef VAR_CACHE
+    os_VCACHE,      // VCACHE
+#endif
 #if HAVE_MODEM
     os_XDOWNLOAD,   // XDOWNLOAD
     os_XUPLOAD,     // XUPLOAD
@@ -134,6 +169,65 @@ void os_LINENO (const char *p)
         }
     }
 
+#ifdef VAR_CACHE
+// *VCACHE [ON|OFF|RESET] - Control and report variable cache
+void os_VCACHE (const char *p)
+    {
+    char sLine[80];
+    if ( strncasecmp (p, "on", 2) == 0 )
+        {
+        varcache_flush ();
+        bVarCache = true;
+        }
+    else if ( strncasecmp (p, "off", 3) == 0 )
+        {
+        bVarCache = false;
+        }
+    else if ( strncasecmp (p, "reset", 5) == 0 )
+        {
+        memset (&vcstats, 0, sizeof (vcstats));
+        }
+    else
+        {
+        sprintf (sLine, "Variable cache %s", bVarCache ? "on" : "off");
+        text (sLine);
+        crlf ();
+        sprintf (sLine, "Hits %u, Chain searches %u, Fills %u, Flushes %u",
+            vcstats.hits, vcstats.misses, vcstats.fills, vcstats.flushes);
+        text (sLine);
+        crlf ();
+        }
+    }
+#endif
+
+#ifdef PROFILE
+// *PROFILE [ON|OFF|REPORT [n]|SAVE file] - Control and report execution profile
+void os_PROFILE (const char *p)
+    {
+    while ( *p == ' ' ) ++p;
+    if ( strncasecmp (p, "on", 2) == 0 )
+        {
+        profile_on ();
+        }
+    else if ( strncasecmp (p, "off", 3) == 0 )
+        {
+        bProfile = false;
+        }
+    else if ( strncasecmp (p, "save", 4) == 0 )
+        {
+        char path[MAX_PATH];
+        setup (path, p + 4, ".csv", ' ', NULL);
+        profile_report (0, path);
+        }
+    else
+        {
+        int n = 10;
+        if ( strncasecmp (p, "report", 6) == 0 ) sscanf (p + 6, "%i", &n);
+        profile_report (n, NULL);
+        }
+    }
+#endif
+
 #if HAVE_MODEM
 void os_XDOWNLOAD (const char *p)
     {
@@ -188,7 +282,7 @@ void os_DISPLAY (const char *p)
     p = setup (path, p, ".bmp", ' ', NULL);
     FILE *fBmp = fopen (path, "rb");
     if ( fBmp == NULL ) error (214,  "File or path not found");
-    int iErr = sload (fBmp);
+    int iErr = srle_ext (path) ? sloadrle (fBmp) : sload (fBmp);
     fclose (fBmp);
     if ( iErr != 0 ) error (iErr, "Invalid Bitmap");
     }
@@ -204,7 +298,7 @@ void os_SCREENSAVE (const char *p)
     p = setup (path, p, ".bmp", ' ', NULL);
     FILE *fBmp = fopen (path, "wb");
     if ( fBmp == NULL ) error (214,  "File or path not found");
-    int iErr = sdump (fBmp);
+    int iErr = srle_ext (path) ? sdumprle (fBmp) : sdump (fBmp);
     fclose (fBmp);
     if ( iErr != 0 ) error (iErr, "Disk fault");
     }
@@ -221,6 +315,9 @@ void org_oscli (char *cmd);
 
 void oscli (char *cmd)
     {
+#ifdef VDU_CORE1
+    vdufence ();
+#endif
 	while (*cmd == ' ') cmd++ ;
 
 	if ((*cmd == 0x0D) || (*cmd == '|'))
@@ -0,0 +1,212 @@
+// profile.c - Statement-level execution profiler
+//
+// When enabled, xeq() calls profile_stmt() at the start of each statement.
+// The time elapsed since the previous statement started is charged to that
+// statement. Times are therefore not strictly exclusive: a statement which
+// calls a PROC or FN is charged only up to the first statement of the callee,
+// and the rest of it, after the return, is charged to the ENDPROC or '='
+// statement that returned. The last statement before a return to immediate
+// mode is counted but not timed. Counts are held in a fixed hash table, keyed
+// on the program address of the statement, outside BASIC memory. Statements
+// are only aggregated into lines, which requires a search of the program,
+// when a report is produced.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "BBC.h"
+#include "profile.h"
+#ifdef PICO
+#include "hardware/timer.h"
+#else
+#include <time.h>
+#endif
+
+void error (int, const char *);
+void text (const char *);
+void crlf (void);
+unsigned short setlin (signed char *, char **);
+
+#if PROFILE < 4
+#error PROFILE must be the log2 of the number of statements recorded, at least 4
+#endif
+#define PRF_SIZE    (1 << PROFILE)
+#define PRF_PROBE   8       // Maximum number of slots tried for a statement
+
+typedef struct
+    {
+    heapptr             site;   // Program address of statement (0 = unused)
+    unsigned int        count;  // Number of times executed
+    unsigned long long  time;   // Total execution time (microseconds)
+    } PRFENTRY;
+
+typedef struct
+    {
+    unsigned int        lino;   // Line number
+    unsigned int        count;  // Number of statements executed
+    unsigned long long  time;   // Total execution time (microseconds)
+    } PRFLINE;
+
+static PRFENTRY prftab[PRF_SIZE];
+static PRFENTRY *prflast = NULL;    // Statement currently being timed
+static unsigned int prftime;        // Time that statement started
+static unsigned int prflost;        // Statements not recorded (table full)
+bool bProfile = false;
+
+// Microsecond timer:
+static inline unsigned int prf_clock (void)
+    {
+#ifdef PICO
+    return time_us_32 ();
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+    }
+
+// Clear the table and start profiling:
+void profile_on (void)
+    {
+    memset (prftab, 0, sizeof (prftab));
+    prflast = NULL;
+    prflost = 0;
+    bProfile = true;
+    }
+
+// Called by xeq() at the start of each statement:
+void profile_stmt (signed char *site)
+    {
+    unsigned int now = prf_clock ();
+    heapptr hp = site - (signed char *) zero;
+    PRFENTRY *pe;
+    int i;
+    // Immediate mode statements are not recorded. Nor is the time until one
+    // starts, since that may include waiting at the command prompt:
+    if ((hp < vpage) || (hp >= lomem))
+        {
+        prflast = NULL;
+        return;
+        }
+    if (prflast != NULL)
+        prflast->time += now - prftime;
+    prftime = now;
+    prflast = NULL;
+    i = (hp ^ (hp >> PROFILE)) & (PRF_SIZE - 1);
+    for (int n = 0; n < PRF_PROBE; ++n)
+        {
+        pe = &prftab[i];
+        if (pe->site == hp)
+            break;
+        if (pe->site == 0)
+            {
+            pe->site = hp;
+            break;
+            }
+        i = (i + 1) & (PRF_SIZE - 1);
+        pe = NULL;
+        }
+    if (pe == NULL)
+        {
+        ++prflost;
+        return;
+        }
+    ++pe->count;
+    prflast = pe;
+    }
+
+static int prf_bylino (const void *a, const void *b)
+    {
+    const PRFLINE *pa = a, *pb = b;
+    return (pa->lino > pb->lino) - (pa->lino < pb->lino);
+    }
+
+static int prf_bytime (const void *a, const void *b)
+    {
+    const PRFLINE *pa = a, *pb = b;
+    return (pa->time < pb->time) - (pa->time > pb->time);
+    }
+
+// List the 'nlines' lines with the greatest execution time, or if 'path' is
+// not NULL write all lines, in line number order, to that file:
+void profile_report (int nlines, const char *path)
+    {
+    char sLine[80];
+    unsigned long long total = 0;
+    PRFLINE *plines;
+    int nused = 0;
+    int i, j;
+    for (i = 0; i < PRF_SIZE; ++i)
+        if (prftab[i].site != 0) ++nused;
+    if (nused == 0)
+        {
+        text ("No profile data");
+        crlf ();
+        return;
+        }
+    plines = (PRFLINE *) malloc (nused * sizeof (PRFLINE));
+    if (plines == NULL)
+        error (0, "No room for profile report");
+    for (i = 0, j = 0; i < PRF_SIZE; ++i)
+        {
+        if (prftab[i].site != 0)
+            {
+            plines[j].lino = setlin (prftab[i].site + (signed char *) zero, NULL);
+            plines[j].count = prftab[i].count;
+            plines[j].time = prftab[i].time;
+            total += prftab[i].time;
+            ++j;
+            }
+        }
+    // Merge statements on the same line
+    qsort (plines, nused, sizeof (PRFLINE), prf_bylino);
+    for (i = 0, j = 0; i < nused; ++i)
+        {
+        if ((j > 0) && (plines[j-1].lino == plines[i].lino))
+            {
+            plines[j-1].count += plines[i].count;
+            plines[j-1].time += plines[i].time;
+            }
+        else
+            plines[j++] = plines[i];
+        }
+    nused = j;
+    if (total == 0) total = 1;
+
+    if (path != NULL)
+        {
+        FILE *f = fopen (path, "w");
+        if (f == NULL)
+            {
+            free (plines);
+            error (214, "File or path not found");
+            }
+        fprintf (f, "Line,Count,Microseconds\n");
+        for (i = 0; i < nused; ++i)
+            fprintf (f, "%u,%u,%llu\n", plines[i].lino, plines[i].count, plines[i].time);
+        fclose (f);
+        free (plines);
+        return;
+        }
+
+    qsort (plines, nused, sizeof (PRFLINE), prf_bytime);
+    if (nlines > nused) nlines = nused;
+    text ("  Line      Count      Time (ms)      %");
+    crlf ();
+    for (i = 0; i < nlines; ++i)
+        {
+        sprintf (sLine, "%6u %10u %14.3f %6.2f", plines[i].lino, plines[i].count,
+            plines[i].time / 1000.0, 100.0 * plines[i].time / total);
+        text (sLine);
+        crlf ();
+        }
+    if (prflost > 0)
+        {
+        sprintf (sLine, "%u statements not recorded (table full)", prflost);
+        text (sLine);
+        crlf ();
+        }
+    free (plines);
+    }
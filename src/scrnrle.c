@@ -0,0 +1,184 @@
+/*  scrnrle.c - Run length compressed screen save files
+
+    A faster and smaller alternative to BMP files for *SCREENSAVE and *DISPLAY.
+    The file consists of:
+
+        "BBRL"
+        int     Width in pixels (characters for mode 7)
+        int     Height in pixels (rows for mode 7)
+        int     Bits per pixel, as held by the display driver
+        int     Number of palette entries
+        int     Reserved (zero)
+        int[]   Palette, as 0x00BBGGRR
+        Rows, top first, each compressed separately using PackBits:
+            n = 0 to 127:   n + 1 literal bytes follow
+            n = 129 to 255: repeat the following byte 257 - n times
+            n = 128:        no operation
+
+    The row data is in the display driver's own format, so it can be written
+    and read without conversion. All file access goes through a buffer.
+*/
+
+#include <string.h>
+#include <strings.h>
+#include "scrnrle.h"
+
+static const char srle_id[4] = { 'B', 'B', 'R', 'L' };
+
+// Test whether a file name has the extension for a compressed screen:
+bool srle_ext (const char *path)
+    {
+    const char *pext = strrchr (path, '.');
+    return ( pext != NULL ) && ( strcasecmp (pext, ".rle") == 0 );
+    }
+
+static int srle_flush (SRLE *ps)
+    {
+    if (( ps->n > 0 ) && ( fwrite (ps->buf, 1, ps->n, ps->f) != ps->n )) return 198;
+    ps->n = 0;
+    return 0;
+    }
+
+static int srle_write (SRLE *ps, const void *pdata, int nbyte)
+    {
+    const uint8_t *pb = (const uint8_t *) pdata;
+    while ( nbyte > 0 )
+        {
+        if ( ps->n == SRLE_BUF )
+            {
+            int iErr = srle_flush (ps);
+            if ( iErr ) return iErr;
+            }
+        int n = SRLE_BUF - ps->n;
+        if ( n > nbyte ) n = nbyte;
+        memcpy (ps->buf + ps->n, pb, n);
+        ps->n += n;
+        pb += n;
+        nbyte -= n;
+        }
+    return 0;
+    }
+
+int srle_wrhdr (SRLE *ps, FILE *f, int wth, int hgt, int nbit, int nclr, const int *prgb)
+    {
+    int hdr[5] = { wth, hgt, nbit, nclr, 0 };
+    ps->f = f;
+    ps->n = 0;
+    int iErr = srle_write (ps, srle_id, sizeof (srle_id));
+    if ( iErr == 0 ) iErr = srle_write (ps, hdr, sizeof (hdr));
+    if ( iErr == 0 ) iErr = srle_write (ps, prgb, nclr * sizeof (int));
+    return iErr;
+    }
+
+// Compress a row into the buffer. Runs of three or more bytes are repeated:
+int srle_wrrow (SRLE *ps, const uint8_t *prow, int nbyte)
+    {
+    int i = 0;
+    while ( i < nbyte )
+        {
+        if ( ps->n > SRLE_BUF - 129 )
+            {
+            int iErr = srle_flush (ps);
+            if ( iErr ) return iErr;
+            }
+        uint8_t *pout = ps->buf + ps->n;
+        int j = i + 1;
+        while (( j < nbyte ) && ( j - i < 128 ) && ( prow[j] == prow[i] )) ++j;
+        if ( j - i >= 3 )
+            {
+            pout[0] = 257 - ( j - i );
+            pout[1] = prow[i];
+            ps->n += 2;
+            }
+        else
+            {
+            j = i;
+            while (( j < nbyte ) && ( j - i < 128 ))
+                {
+                if (( j + 2 < nbyte ) && ( prow[j] == prow[j+1] ) && ( prow[j] == prow[j+2] )) break;
+                ++j;
+                }
+            pout[0] = j - i - 1;
+            memcpy (pout + 1, prow + i, j - i);
+            ps->n += j - i + 1;
+            }
+        i = j;
+        }
+    return 0;
+    }
+
+int srle_wrend (SRLE *ps)
+    {
+    return srle_flush (ps);
+    }
+
+static bool srle_fill (SRLE *ps)
+    {
+    if ( ps->i < ps->n ) return true;
+    ps->n = fread (ps->buf, 1, SRLE_BUF, ps->f);
+    ps->i = 0;
+    return ( ps->n > 0 );
+    }
+
+static int srle_getc (SRLE *ps)
+    {
+    if ( ! srle_fill (ps) ) return -1;
+    return ps->buf[ps->i++];
+    }
+
+static bool srle_read (SRLE *ps, void *pdata, int nbyte)
+    {
+    uint8_t *pb = (uint8_t *) pdata;
+    while ( nbyte > 0 )
+        {
+        if ( ! srle_fill (ps) ) return false;
+        int n = ps->n - ps->i;
+        if ( n > nbyte ) n = nbyte;
+        memcpy (pb, ps->buf + ps->i, n);
+        ps->i += n;
+        pb += n;
+        nbyte -= n;
+        }
+    return true;
+    }
+
+// Read and check the header. The palette is returned in prgb:
+int srle_rdhdr (SRLE *ps, FILE *f, int wth, int hgt, int nbit, int nclr, int *prgb)
+    {
+    char id[4];
+    int hdr[5];
+    ps->f = f;
+    ps->n = 0;
+    ps->i = 0;
+    if (( ! srle_read (ps, id, sizeof (id)) ) || ( memcmp (id, srle_id, sizeof (id)) != 0 )
+        || ( ! srle_read (ps, hdr, sizeof (hdr)) )) return 255;
+    if (( hdr[0] != wth ) || ( hdr[1] != hgt ) || ( hdr[2] != nbit ) || ( hdr[3] != nclr )) return 25;
+    if ( ! srle_read (ps, prgb, nclr * sizeof (int)) ) return 255;
+    return 0;
+    }
+
+// Decompress a row straight into the destination:
+int srle_rdrow (SRLE *ps, uint8_t *prow, int nbyte)
+    {
+    uint8_t *pend = prow + nbyte;
+    while ( prow < pend )
+        {
+        int n = srle_getc (ps);
+        if ( n < 0 ) return 255;
+        if ( n < 128 )
+            {
+            ++n;
+            if (( n > pend - prow ) || ( ! srle_read (ps, prow, n) )) return 255;
+            prow += n;
+            }
+        else if ( n > 128 )
+            {
+            n = 257 - n;
+            int c = srle_getc (ps);
+            if (( c < 0 ) || ( n > pend - prow )) return 255;
+            memset (prow, c, n);
+            prow += n;
+            }
+        }
+    return 0;
+    }
@@ -21,6 +21,11 @@
 #include "vducmd.h"
 #include "bbccon.h"
 #include "lfswrap.h"
+#ifdef VDU_CORE1
+#include <setjmp.h>
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#endif
 
 #if BBC_FONT == 0
 #include "font_10.h"
@@ -28,19 +33,33 @@
 
 // Defined in bbmain.c:
 void error (int, const char *);
+#ifdef VDU_CORE1
+// Errors raised on core 1 are passed back to the interpreter
+static void vduerror (int iErr, const char *psErr);
+#define error vduerror
+#endif
 
 // Defined in bbpico.c:
 extern int getkey (unsigned char *pkey);
 extern void bell (void);
+extern void conflush (void);
+extern int conputc (int c);
+extern int conprintf (const char *psFmt, ...);
+
+// Printer output goes through the console buffer, to stay in order with other output:
+#undef putchar
+#define printf(...) conprintf (__VA_ARGS__)
+#define putchar(c)  conputc (c)
 // void *gethwm (void);
 
 #if REF_MODE & 2
 extern void *himem;
 extern void *libase;
 extern void *libtop;
-static int *vduque = NULL;
-static int *vduqbot = NULL;
-static int *vduqtop = NULL;
+static uint8_t *vduque = NULL;
+static uint8_t *vduqbot = NULL;
+static uint8_t *vduqtop = NULL;
+static uint8_t *vduqplt = NULL;
 static int nRefQue;
 heapptr oshwm (void *addr, int settop);
 #endif
@@ -217,6 +236,21 @@ static void dispchr (int chr)
         }
     }
 
+// Paged mode: wait for a key press:
+static void pagewait (void)
+    {
+    unsigned char ch;
+    do
+        {
+        usleep (5000);
+        } 
+    while ((getkey (&ch) == 0) && ((flags & (ESCFLG | KILL)) == 0));
+    }
+
+#ifdef VDU_CORE1
+static void vdupagewait (void);
+#endif
+
 static void newline (int *px, int *py)
     {
     hidecsr ();
@@ -224,13 +258,12 @@ static void newline (int *px, int *py)
         {
         if ((scroln & 0x80) && (--scroln == 0x7F))
             {
-            unsigned char ch;
             scroln = 0x80 + tvb - tvt + 1;
-            do
-                {
-                usleep (5000);
-                } 
-            while ((getkey (&ch) == 0) && ((flags & (ESCFLG | KILL)) == 0));
+#ifdef VDU_CORE1
+            if ( get_core_num () != 0 ) vdupagewait ();
+            else
+#endif
+            pagewait ();
             }
         scrlup ();
         *py = tvb;
@@ -384,6 +417,15 @@ static void clippoint  (int clrop, int xp, int yp)
 #define SKIP_FIRST  -1
 #define SKIP_LAST   1
 
+#define LINE_BOX    4           // Largest ratio of bounding box to line length sent as one update
+
+// Draw one run of a line, updating the display now unless the whole box is sent at the end:
+static inline void linerun (int clrop, int xp1, int xp2, int yp, bool bBox)
+    {
+    if ( bBox ) hspan (clrop, xp1, xp2, yp);
+    else hline (clrop, xp1, xp2, yp);
+    }
+
 static void line (int clrop, uint32_t xp1, uint32_t yp1, uint32_t xp2, uint32_t yp2, uint32_t dots, int skip)
     {
 #if DEBUG & 2
@@ -430,6 +472,15 @@ static void line (int clrop, uint32_t xp1, uint32_t yp1, uint32_t xp2, uint32_t
         yd  = -yd;
         skip = -skip;
         }
+    // Bounds of the line. A line close to horizontal or vertical is sent to the display
+    // as one rectangle; otherwise the box would be mostly untouched pixels, so each run
+    // is reported as it is drawn (merged by hline when replaying the VDU queue)
+    int xb1 = ( xd >= 0 ) ? xp1 : xp2;
+    int xb2 = ( xd >= 0 ) ? xp2 : xp1;
+    int yb1 = ( yd >= 0 ) ? yp1 : yp2;
+    int yb2 = ( yd >= 0 ) ? yp2 : yp1;
+    int npix = ( bVert ? yd : xd ) + 1;
+    bool bBox = ( (xb2 - xb1 + 1) * (yb2 - yb1 + 1) <= LINE_BOX * npix );
     if ( bVert )
         {
 #if DEBUG & 2
@@ -469,7 +520,7 @@ static void line (int clrop, uint32_t xp1, uint32_t yp1, uint32_t xp2, uint32_t
             {
             if ( dots & 1 )
                 {
-                point (clrop, xp1, yp1);
+                linerun (clrop, xp1, xp1, yp1, bBox);
                 dots >>= 1;
                 dots |= 0x80000000;
                 }
@@ -521,27 +572,46 @@ static void line (int clrop, uint32_t xp1, uint32_t yp1, uint32_t xp2, uint32_t
             {
             --xp2;
             }
+        // Collect consecutive pixels on the same row into runs, drawn as spans
+        bool bRun = false;
+        uint32_t xr = xp1;
         while ( xp1 <= xp2 )
             {
             if ( dots & 1 )
                 {
-                point (clrop, xp1, yp1);
+                if ( ! bRun )
+                    {
+                    xr = xp1;
+                    bRun = true;
+                    }
                 dots >>= 1;
                 dots |= 0x80000000;
                 }
             else
                 {
+                if ( bRun )
+                    {
+                    linerun (clrop, xr, xp1 - 1, yp1, bBox);
+                    bRun = false;
+                    }
                 dots >>= 1;
                 }
             ya += yd;
             if ( ya >= xd )
                 {
+                if ( bRun )
+                    {
+                    linerun (clrop, xr, xp1, yp1, bBox);
+                    bRun = false;
+                    }
                 yp1 += ys;
                 ya -= xd;
                 }
             ++xp1;
             }
+        if ( bRun ) linerun (clrop, xr, xp2, yp1, bBox);
         }
+    if ( bBox ) rectout (xb1, yb1, xb2 + 1, yb2 + 1);
     }
 
 static void clipline (int clrop, int xp1, int yp1, int xp2, int yp2, uint32_t dots, int skip)
@@ -829,12 +899,18 @@ static void gwind (int vl, int vb, int vr, int vt)
 // Get text cursor (caret) coordinates:
 void getcsr(int *px, int *py)
     {
+#ifdef VDU_CORE1
+    vdufence ();
+#endif
     if ( px ) *px = xcsr - tvl;
     if ( py ) *py = ycsr - tvt;
     }
 
 int vpoint (int xp, int yp)
     {
+#ifdef VDU_CORE1
+    vdufence ();
+#endif
     xp = gxscale (xp);
     yp = gyscale (yp);
     if (( xp < gvl ) || ( xp > gvr ) || ( yp < gvt ) || ( yp > gvb )) return -1;
@@ -850,6 +926,9 @@ int vtint (int xp, int yp)
 
 int vgetc (int x, int y)
     {
+#ifdef VDU_CORE1
+    vdufence ();
+#endif
     if (( x == 0x80000000 ) && ( y == 0x80000000 ))
         {
         x = xcsr;
@@ -908,6 +987,9 @@ int vgetc (int x, int y)
 // Get string width in graphics units:
 int widths (unsigned char *s, int l)
     {
+#ifdef VDU_CORE1
+    vdufence ();
+#endif
 	return ( 8 * l ) << xshift;
     }
 
@@ -959,12 +1041,12 @@ typedef struct
     int     clrop;
     bool    bEq;
     uint8_t tclr;
+    uint32_t inset;     // Set of colours to be filled (bit n set for colour n)
     } FILLINFO;
 
-static inline bool doflood (FILLINFO *pfi, int xp, int yp)
+// Test whether a pixel of colour pclr is to be filled:
+static inline bool fillclr (const FILLINFO *pfi, uint8_t pclr)
     {
-    if (( xp < gvl ) || ( xp > gvr ) || ( yp < gvt ) || ( yp > gvb )) return false;
-    uint8_t pclr = getpix (xp, yp);
     bool bRes = ( pclr == pfi->tclr );
     if ( ! pfi->bEq ) bRes = ! bRes;
     if ( bRes )
@@ -983,19 +1065,25 @@ static inline bool doflood (FILLINFO *pfi, int xp, int yp)
                 break;
             }
         }
+    return bRes;
+    }
+
+static inline bool doflood (FILLINFO *pfi, int xp, int yp)
+    {
+    if (( xp < gvl ) || ( xp > gvr ) || ( yp < gvt ) || ( yp > gvb )) return false;
+    uint8_t pclr = getpix (xp, yp);
+    bool bRes = (( pfi->inset & ( 1 << pclr )) != 0 );
 #if DEBUG & 8
     printf ("doflood (%d, %d) pclr = 0x%02X, bRes = %s\n", xp, yp, pclr, bRes ? "True": "False");
 #endif
     return bRes;
     }
 
-#if 1
 // Fill a region without overflowing stack. Based upon:
 // "Space-efficient Region Filling in Raster Graphics", Dominik Henrich
 // "The Visual Computer: An International Journal of Computer Graphics", vol 10, no 4, pp 205-215, 1994.
-
-// Number of additional cursors. In theory non zero values should speed complex fills.
-#define MFILLCSR    0
+// A cursor follows the edge of the unfilled part of the region, keeping the edge on its
+// right, and fills each pixel which is not needed to keep that part connected.
 
 static void FCurMove (FILLINFO *pfi, int iDir, int *pX, int *pY, int *pW)
     {
@@ -1070,20 +1158,6 @@ static int FCurRight (int iDir, int iW)
     return iDir;
     }
 
-static int FCurLeft (int iDir, int iW)
-    {
-#if DEBUG & 8
-    printf ("FCurLeft (%d, 0x%03X)", iDir, iW);
-#endif
-    if ( ( iW & 0x0AA ) == 0x0AA ) error (255, "Fill stuck");
-    iDir = ( iDir + 3 ) & 3;
-    while ( iW & iDirMask[iDir] ) iDir = ( iDir + 1 ) & 3;
-#if DEBUG & 8
-    printf (" = %d\n", iDir);
-#endif
-    return iDir;
-    }
-
 static int FCurSet (FILLINFO *pfi, int iX, int iY, int iW)
     {
 #if DEBUG & 8
@@ -1123,27 +1197,100 @@ static bool FCurCrit (int iW)
     return bCrit;
     }
 
-static bool LeftCycle (FILLINFO *pfi, int iXC, int iYC, int iDC, int iW)
+typedef struct
     {
-#if DEBUG & 8
-    printf ("LeftCycle (%d, %d, %d, 0x%03X)\n", iXC, iYC, iDC, iW);
-#endif
-    iDC = FCurLeft (iDC, iW);
-    int iX = iXC;
-    int iY = iYC;
-    int iDir = iDC;
-    FCurMove (pfi, iDir, &iX, &iY, &iW);
-    while (( iX != iXC ) || ( iY != iYC ))
+    int     iX;         // Current position
+    int     iY;
+    int     iDir;       // Current direction
+    int     iXS;        // Starting position
+    int     iYS;
+    int     iDS;        // Starting direction
+    int     iSeen;      // Neighbours of the removed pixel reached (bit n for direction n)
+    } FILLTRACE;
+
+static const int iDirX[4] = { 1, 0, -1, 0 };
+static const int iDirY[4] = { 0, 1, 0, -1 };
+
+// Start a trace at the neighbour of (iXC, iYC) in direction iDir, with (iXC, iYC) on its left:
+static void FCurTrInit (FILLTRACE *pft, int iXC, int iYC, int iDir)
+    {
+    pft->iX = pft->iXS = iXC + iDirX[iDir];
+    pft->iY = pft->iYS = iYC + iDirY[iDir];
+    pft->iDir = pft->iDS = ( iDir + 3 ) & 3;
+    pft->iSeen = 1 << iDir;
+    }
+
+static void FCurTrSeen (FILLTRACE *pft, int iXC, int iYC)
+    {
+    for (int iDir = 0; iDir < 4; ++iDir)
+        if (( pft->iX == iXC + iDirX[iDir] ) && ( pft->iY == iYC + iDirY[iDir] )) pft->iSeen |= 1 << iDir;
+    }
+
+/*  Advance a trace one step along the edge of the region, with (iXC, iYC) removed, keeping
+    the edge on its left. Returns false once the trace is back where it started */
+static bool FCurTrace (FILLINFO *pfi, FILLTRACE *pft, int iXC, int iYC)
+    {
+    int iXF = pft->iX + iDirX[pft->iDir];
+    int iYF = pft->iY + iDirY[pft->iDir];
+    if ( (( iXF == iXC ) && ( iYF == iYC )) || ( ! doflood (pfi, iXF, iYF) ) )
         {
-        if ( ! FCurCrit (iW) ) iW = FCurSet (pfi, iX, iY, iW);
-        iDir = FCurLeft (iDir, iW);
-        FCurMove (pfi, iDir, &iX, &iY, &iW);
+        pft->iDir = ( pft->iDir + 1 ) & 3;
+        }
+    else
+        {
+        pft->iX = iXF;
+        pft->iY = iYF;
+        FCurTrSeen (pft, iXC, iYC);
+        int iDL = ( pft->iDir + 3 ) & 3;
+        iXF += iDirX[iDL];
+        iYF += iDirY[iDL];
+        if ( (( iXF != iXC ) || ( iYF != iYC )) && doflood (pfi, iXF, iYF) )
+            {
+            pft->iX = iXF;
+            pft->iY = iYF;
+            pft->iDir = iDL;
+            FCurTrSeen (pft, iXC, iYC);
+            }
         }
-    iDir = FCurLeft (iDir, iW);
+    return ( pft->iX != pft->iXS ) || ( pft->iY != pft->iYS ) || ( pft->iDir != pft->iDS );
+    }
+
+/*  Test whether the pixel at (iXC, iYC), which FCurCrit has found to separate its
+    neighbours locally, joins parts of the region that are not otherwise connected.
+    Trace the edge of the region with the pixel removed, from two neighbours which are
+    not joined locally. The pixel is not needed if a trace reaches all the neighbours,
+    and is needed if a trace gets back to its start first. The traces are run together,
+    so that the time taken depends upon the smaller part */
+static bool FCurCut (FILLINFO *pfi, int iXC, int iYC, int iW)
+    {
+    static const int iRing[8] = { 0x020, 0x100, 0x080, 0x040, 0x008, 0x001, 0x002, 0x004 };
 #if DEBUG & 8
-    printf ("Completed LeftCycle: iDir = %d, iDC = %d, %s\n", iDir, iDC, (iDir == iDC ) ? "True" : "False");
+    printf ("FCurCut (%d, %d, 0x%03X)\n", iXC, iYC, iW);
+#endif
+    int iNbr = 0;
+    for (int iDir = 0; iDir < 4; ++iDir)
+        if ( ( iW & iDirMask[iDir] ) == 0 ) iNbr |= 1 << iDir;
+    // First neighbour, and those joined to it around the ring of surrounding pixels
+    int iD1 = 0;
+    while ( ( iNbr & ( 1 << iD1 ) ) == 0 ) ++iD1;
+    int iLocal = 1 << iD1;
+    for (int i = 2 * iD1 + 1; ( iW & iRing[i & 7] ) == 0; ++i)
+        if ( ( i & 1 ) == 0 ) iLocal |= 1 << (( i & 7 ) >> 1);
+    for (int i = 2 * iD1 + 7; ( iW & iRing[i & 7] ) == 0; --i)
+        if ( ( i & 1 ) == 0 ) iLocal |= 1 << (( i & 7 ) >> 1);
+    int iD2 = 0;
+    while ( ( ( iNbr & ~ iLocal ) & ( 1 << iD2 ) ) == 0 ) ++iD2;
+    FILLTRACE ft1, ft2;
+    FCurTrInit (&ft1, iXC, iYC, iD1);
+    FCurTrInit (&ft2, iXC, iYC, iD2);
+    while ( FCurTrace (pfi, &ft1, iXC, iYC) && FCurTrace (pfi, &ft2, iXC, iYC) )
+        {
+        if (( ft1.iSeen == iNbr ) || ( ft2.iSeen == iNbr )) return false;
+        }
+#if DEBUG & 8
+    printf ("FCurCut: cut\n");
 #endif
-    return ( iDir == iDC );
+    return true;
     }
 
 static void FillInit (FILLINFO *pfi, int *pX, int *pY, int *pW)
@@ -1172,125 +1319,101 @@ static void FillInit (FILLINFO *pfi, int *pX, int *pY, int *pW)
 #endif
     }
 
-#if MFILLCSR > 0
-static int nfcur = 0;
-
-static struct
-    {
-    int iX;
-    int iY;
-    int iDir;
-    } fcurstk[MFILLCSR];
-
-static void FCurPush (int iX, int iY, int iDir)
-    {
-    fcurstk[nfcur].iX = iX;
-    fcurstk[nfcur].iY = iY;
-    fcurstk[nfcur].iDir = iDir;
-    ++nfcur;
-    }
-
-static bool FCurPop (FILLINFO *pfi, int *pX, int *pY, int *pDir, int *pW)
-    {
-    while ( nfcur > 0 )
-        {
-        --nfcur;
-        int iX = fcurstk[nfcur].iX;
-        int iY = fcurstk[nfcur].iY;
-        int iDir = fcurstk[nfcur].iDir;
-        int iW = 0;
-        if ( ! doflood (pfi, iX-1, iY-1) ) iW |= 0x001;
-        if ( ! doflood (pfi, iX  , iY-1) ) iW |= 0x002;
-        if ( ! doflood (pfi, iX+1, iY-1) ) iW |= 0x004;
-        if ( ! doflood (pfi, iX-1, iY  ) ) iW |= 0x008;
-        if ( ! doflood (pfi, iX  , iY  ) ) iW |= 0x010;
-        if ( ! doflood (pfi, iX+1, iY  ) ) iW |= 0x020;
-        if ( ! doflood (pfi, iX-1, iY+1) ) iW |= 0x040;
-        if ( ! doflood (pfi, iX  , iY+1) ) iW |= 0x080;
-        if ( ! doflood (pfi, iX+1, iY+1) ) iW |= 0x100;
-        if ( ( iW & 0x1EF ) != 0x1EF )
-            {
-            *pX = iX;
-            *pY = iY;
-            *pDir = iDir;
-            *pW = iW;
-            return true;
-            }
-        if ( iW == 0x1EF ) point (pf->clrop, iX, iY);
-        }
-    return false;
-    }
-#endif
-
-static void flood (bool bEq, uint8_t tclr, int clrop, int iX, int iY)
+static void cflood (FILLINFO *pfi, int iX, int iY)
     {
 #if DEBUG & 2
-    printf ("flood (%d, 0x%02X, 0x%02X, %d, %d)\n", bEq, tclr, clrop, iX, iY);
+    printf ("cflood (%d, %d)\n", iX, iY);
 #endif
-    FILLINFO fi;
-    fi.clrop = clrop;
-    fi.bEq = bEq;
-    fi.tclr = tclr;
-    int iDir = 0;
+    int iDir = 3;
     int iW;
-    FillInit (&fi, &iX, &iY, &iW);
+    FillInit (pfi, &iX, &iY, &iW);
     while (true)
         {
-        if ( ( iW & 0x1EF ) == 0x1EF )
+        if ( ( iW & 0x0AA ) == 0x0AA )
             {
-            iW = FCurSet (&fi, iX, iY, iW);
-#if MFILLCSR > 0
-            if ( ! FCurPop (&fi, &iX, &iY, &iDir, &iW) ) return;
-#else
+            FCurSet (pfi, iX, iY, iW);
             return;
-#endif
-            }
-        if ( FCurCrit (iW) )
-            {
-#if MFILLCSR > 0
-            if ( nfcur <= MFILLCSR )
-                {
-                FCurPush (iX, iY, iDir);
-                iW |= 0x010;
-                }
-            else if ( LeftCycle (&fi, iX, iY, iDir, iW) ) iW |= 0x010;
-#else
-            if ( LeftCycle (&fi, iX, iY, iDir, iW) ) iW |= 0x010;
-#endif
-            }
-        else
-            {
-            iW = FCurSet (&fi, iX, iY, iW);
             }
+        if ( ( ! FCurCrit (iW) ) || ( ! FCurCut (pfi, iX, iY, iW) ) ) iW = FCurSet (pfi, iX, iY, iW);
         iDir = FCurRight (iDir, iW);
-        FCurMove (&fi, iDir, &iX, &iY, &iW);
+        FCurMove (pfi, iDir, &iX, &iY, &iW);
         }
     }
 
-#else
-// Traditional recursive fill. Fast but has excessive stack use for complex fills.
-static void flood2 (FILLINFO *pfi, int xp, int yp)
+/*  Scanline fill, based upon "A Seed Fill Algorithm", Paul Heckbert, Graphics Gems, 1990.
+    Each stacked span is a run of pixels on the row adjacent to a run already filled,
+    which has to be searched for pixels to fill. The display driver (fillscan) finds the
+    extent of each run, testing whole words of pixels at a time where it can.
+
+    The span stack is of fixed size. If it fills, the region containing the span that
+    could not be stacked is filled by the cursor walk above, which needs no storage.
+    Both depend upon filled pixels no longer matching, so for the exclusive-or and
+    invert actions the colours which plotting would leave matching are not filled.
+*/
+
+#ifndef NFILLSPAN
+#define NFILLSPAN   256     // Size of span stack
+#endif
+
+typedef struct
     {
-#if DEBUG & 2
-    printf ("flood2 (%d, %d)\n", xp, yp);
+    short   y;              // Row to search
+    short   xl;             // Left end of span
+    short   xr;             // Right end of span
+    short   dy;             // Direction of search (row filled is y - dy)
+    } FILLSPAN;
+
+static FILLSPAN fillspan[NFILLSPAN];
+static int nfillspan;
+
+static void fillpush (FILLINFO *pfi, int y, int xl, int xr, int dy)
+    {
+    if (( y < gvt ) || ( y > gvb )) return;
+    if ( nfillspan < NFILLSPAN )
+        {
+        FILLSPAN *pfs = &fillspan[nfillspan++];
+        pfs->y = y;
+        pfs->xl = xl;
+        pfs->xr = xr;
+        pfs->dy = dy;
+        return;
+        }
+#if DEBUG & 8
+    printf ("fillpush: stack full, fill (%d - %d, %d) by cursor\n", xl, xr, y);
 #endif
-    if ( ! doflood (&fi, xp, yp) ) return;
-    int xl = xp;
-    int xr = xp;
-    while ( doflood (&fi, xl-1, yp) ) --xl;
-    while ( doflood (&fi, xr+1, yp) ) ++xr;
-    hdraw (clrop, xl, xr, yp);
-    int xc = ( xl + xr ) / 2;
-    int yt = yp;
-    while ( doflood (&fi, xc, yt-1) ) --yt;
-    if ( yt < yp - 1 ) flood2 (pfi, xc, (yp + yt) / 2);
-    int yb = yp;
-    while ( doflood (&fi, xc, yb+1) ) ++yb;
-    if ( yb > yp + 1 ) flood2 (pfi, xc, (yp + yb) / 2);
-    for (int xx = xl; xx <= xr; ++xx)
+    uint32_t outset = ~ pfi->inset;
+    while ( xl <= xr )
+        {
+        xl += fillscan (xl, y, xr, outset);
+        if ( xl > xr ) break;
+        cflood (pfi, xl, y);
+        ++xl;
+        }
+    }
+
+static void fillrow (FILLINFO *pfi, int y, int x1, int x2, int dy)
+    {
+    uint32_t outset = ~ pfi->inset;
+    int x = x1;
+    int xl;
+    int n = fillscan (x1, y, gvl, pfi->inset);
+    if ( n > 0 ) xl = x1 - n + 1;
+    else
+        {
+        x += fillscan (x1, y, x2, outset);
+        xl = x;
+        }
+    while ( x <= x2 )
         {
-        if ( doflood (pfi, xx, yp-1) ) flood2 (pfi, xx, yp-1);
-        if ( doflood (pfi, xx, yp+1) ) flood2 (pfi, xx, yp+1);
+        int xr = x + fillscan (x, y, gvr, pfi->inset) - 1;
+        hline (pfi->clrop, xl, xr, y);
+        fillpush (pfi, y + dy, xl, xr, dy);
+        if ( xl < x1 ) fillpush (pfi, y - dy, xl, x1 - 1, - dy);
+        if ( xr > x2 ) fillpush (pfi, y - dy, x2 + 1, xr, - dy);
+        x = xr + 2;
+        if ( x > x2 ) break;
+        x += fillscan (x, y, x2, outset);
+        xl = x;
         }
     }
 
@@ -1303,9 +1426,31 @@ static void flood (bool bEq, uint8_t tclr, int clrop, int xp, int yp)
     fi.clrop = clrop;
     fi.bEq = bEq;
     fi.tclr = tclr;
-    flood2 (&fi, xp, yp);
+    fi.inset = 0;
+    for (int i = 0; i <= cmsk; ++i)
+        if ( fillclr (&fi, i) ) fi.inset |= 1 << i;
+    int op = clrop >> 8;
+    if (( op == 3 ) || ( op == 4 ))
+        {
+        // Leave unfilled any colour which plotting keeps in the set
+        uint32_t inset = fi.inset;
+        uint8_t fclr = clrmsk (clrop);
+        for (int i = 0; i <= cmsk; ++i)
+            {
+            int j = ( op == 3 ) ? ( i ^ fclr ) : ( ~ i & cmsk );
+            if ( inset & ( 1 << j ) ) fi.inset &= ~ ( 1 << i );
+            }
+        }
+    if ( ! doflood (&fi, xp, yp) ) return;
+    nfillspan = 0;
+    fillpush (&fi, yp + 1, xp, xp, 1);
+    fillpush (&fi, yp, xp, xp, -1);
+    while ( nfillspan > 0 )
+        {
+        FILLSPAN *pfs = &fillspan[--nfillspan];
+        fillrow (&fi, pfs->y, pfs->xl, pfs->xr, pfs->dy);
+        }
     }
-#endif
 
 static int iroot (int s)
     {
@@ -1338,56 +1483,22 @@ static void ellipse (bool bFill, int clrop, int xc, int yc, uint32_t aa, uint32_
 #if DEBUG & 2
     printf ("ellipse (%d, 0x%02X, (%d, %d), %d, %d, %lld)\n", bFill, clrop, xc, yc, aa, bb, dd);
 #endif
+    // Incremental form of aa * xp^2 + bb * yp^2 <= dd: as yp increases xp can only
+    // decrease, so each row just steps xp down until the point is inside the ellipse
     uint32_t xp = pmode->gcol;
+    uint64_t qq = dd / aa;
+    if ( qq < xp * xp ) xp = iroot (qq) + 1;
     uint32_t yp = 0;
     uint32_t xl = 0;
-    int dx = 0;
-    while ( true )
-        {
-        uint32_t sq = yp * yp;
-        uint64_t pp = ((uint64_t) bb) * ((uint64_t) sq);
-        if ( pp > dd ) break;
-        uint64_t qq = dd - pp;
-        sq = xp * xp;
-        pp = ((uint64_t) aa) * ((uint64_t) sq);
-        if ( pp > qq )
+    uint64_t ax2 = ((uint64_t) aa) * ((uint64_t) ( xp * xp ));     // aa * xp^2
+    uint64_t by2 = 0;                                               // bb * yp^2
+    while ( by2 <= dd )
+        {
+        qq = dd - by2;
+        while ( ax2 > qq )
             {
-            int x1 = 0;
-            int x2 = xp;
-            while ( x2 - x1 > 1 )
-                {
-                if ( dx > 0 )
-                    {
-                    xp = x2 - dx;
-                    dx *= 2;
-                    if ( xp < x1 )
-                        {
-                        xp = ( x1 + x2 ) / 2;
-                        dx = 0;
-                        }
-                    }
-                else
-                    {
-                    xp = ( x1 + x2 ) / 2;
-                    }
-                sq = xp * xp;
-                pp = ((uint64_t) aa) * ((uint64_t) sq);
-                if ( pp > qq )
-                    {
-                    x2 = xp;
-                    }
-                else if ( pp == qq )
-                    {
-                    x1 = xp;
-                    break;
-                    }
-                else
-                    {
-                    x1 = xp;
-                    dx = 0;
-                    }
-                }
-            xp = x1;
+            ax2 -= ((uint64_t) aa) * ( 2 * xp - 1 );
+            --xp;
             }
         if ( yp == 0 )
             {
@@ -1395,7 +1506,6 @@ static void ellipse (bool bFill, int clrop, int xc, int yc, uint32_t aa, uint32_
                 {
                 hdraw (clrop, xc - xp, xc + xp, yc + yp);
                 }
-            dx = 1;
             }
         else if ( bFill )
             {
@@ -1431,9 +1541,8 @@ static void ellipse (bool bFill, int clrop, int xc, int yc, uint32_t aa, uint32_
                 hdraw (clrop, xc - xl, xc - xp - 1, yc - yp + 1);
                 }
             }
-        dx = xl - xp;
-        if ( dx <= 0 ) dx = 1;
         xl = xp;
+        by2 += ((uint64_t) bb) * ( 2 * yp + 1 );
         ++yp;
         }
     if ( ! bFill )
@@ -1594,8 +1703,11 @@ static void arc (int clrop)
     yp >>= yshift;
     xe >>= xshift;
     ye >>= yshift;
-    int xs = 2 * xshift;
-    int ys = 2 * yshift;
+    // Scale factors for squared distances, and the squared radius of the current point,
+    // updated as the point moves rather than recalculated
+    int xs = 1 << ( 2 * xshift );
+    int ys = 1 << ( 2 * yshift );
+    int e = xp * xp * xs + yp * yp * ys;
 #if DEBUG & 2
     printf ("Octant %d\n", iOct);
 #endif
@@ -1606,8 +1718,13 @@ static void arc (int clrop)
             {
             case 0:
                 ++yp;
-                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) --xp;
-                if ( (yp << ys) >= (xp << xs) )
+                e += ( 2 * yp - 1 ) * ys;
+                if ( e > r2 )
+                    {
+                    --xp;
+                    e -= ( 2 * xp + 1 ) * xs;
+                    }
+                if ( yp * ys >= xp * xs )
                     {
                     ++iOct;
 #if DEBUG & 2
@@ -1618,8 +1735,14 @@ static void arc (int clrop)
                 break;
             case 1:
                 --xp;
+                e -= ( 2 * xp + 1 ) * xs;
                 ++yp;
-                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) --yp;
+                e += ( 2 * yp - 1 ) * ys;
+                if ( e > r2 )
+                    {
+                    --yp;
+                    e -= ( 2 * yp + 1 ) * ys;
+                    }
                 if ( xp <= 0 )
                     {
                     ++iOct;
@@ -1631,8 +1754,13 @@ static void arc (int clrop)
                 break;
             case 2:
                 --xp;
-                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) --yp;
-                if ( (yp << ys) <= ((-xp) << xs) )
+                e -= ( 2 * xp + 1 ) * xs;
+                if ( e > r2 )
+                    {
+                    --yp;
+                    e -= ( 2 * yp + 1 ) * ys;
+                    }
+                if ( yp * ys <= (-xp) * xs )
                     {
                     ++iOct;
 #if DEBUG & 2
@@ -1643,8 +1771,14 @@ static void arc (int clrop)
                 break;
             case 3:
                 --yp;
+                e -= ( 2 * yp + 1 ) * ys;
                 --xp;
-                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) ++xp;
+                e -= ( 2 * xp + 1 ) * xs;
+                if ( e > r2 )
+                    {
+                    ++xp;
+                    e += ( 2 * xp - 1 ) * xs;
+                    }
                 if ( yp <= 0 )
                     {
                     ++iOct;
@@ -1656,8 +1790,13 @@ static void arc (int clrop)
                 break;
             case 4:
                 --yp;
-                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) ++xp;
-                if ( (yp << ys) <= (xp << xs) )
+                e -= ( 2 * yp + 1 ) * ys;
+                if ( e > r2 )
+                    {
+                    ++xp;
+                    e += ( 2 * xp - 1 ) * xs;
+                    }
+                if ( yp * ys <= xp * xs )
                     {
                     ++iOct;
 #if DEBUG & 2
@@ -1668,8 +1807,14 @@ static void arc (int clrop)
                 break;
             case 5:
                 ++xp;
+                e += ( 2 * xp - 1 ) * xs;
                 --yp;
-                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) ++yp;
+                e -= ( 2 * yp + 1 ) * ys;
+                if ( e > r2 )
+                    {
+                    ++yp;
+                    e += ( 2 * yp - 1 ) * ys;
+                    }
                 if ( xp >= 0 )
                     {
                     ++iOct;
@@ -1681,8 +1826,13 @@ static void arc (int clrop)
                 break;
             case 6:
                 ++xp;
-                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) ++yp;
-                if ( (xp << xs) >= ((-yp) << ys) )
+                e += ( 2 * xp - 1 ) * xs;
+                if ( e > r2 )
+                    {
+                    ++yp;
+                    e += ( 2 * yp - 1 ) * ys;
+                    }
+                if ( xp * xs >= (-yp) * ys )
                     {
                     ++iOct;
 #if DEBUG & 2
@@ -1693,8 +1843,14 @@ static void arc (int clrop)
                 break;
             case 7:
                 ++yp;
+                e += ( 2 * yp - 1 ) * ys;
                 ++xp;
-                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) --xp;
+                e += ( 2 * xp - 1 ) * xs;
+                if ( e > r2 )
+                    {
+                    --xp;
+                    e -= ( 2 * xp + 1 ) * xs;
+                    }
                 if ( yp >= 0 )
                     {
                     ++iOct;
@@ -1935,6 +2091,7 @@ static void defchr (uint8_t chr, uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3,
     *(++pblk) = b5;
     *(++pblk) = b6;
     *(++pblk) = b7;
+    newglyph ();
     }
 
 /* Process character sequences:
@@ -2280,6 +2437,72 @@ static void vdu_22 (int code, int data1, int data2)
     return;
     }
 
+/*  Sprite commands, VDU 23,27,cmd,n,a0,a1,a2,a3,b (a = 32-bit little-endian parameter):
+    cmd = 0: Set size (a = width + 65536 * height) and transparent colour (b) for cmd 1
+          1: Define sprite n from bitmap at address a, in the pixel format of the current mode
+          2: Show sprite n at graphics position (x, y) (a = x + 65536 * y) using GCOL action b
+          3: Hide sprite n
+          4: Hide and delete all sprites
+*/
+static int sprw = 0;                    // Width of sprite to define
+static int sprh = 0;                    // Height of sprite to define
+static int sprkey = 255;                // Transparent colour of sprite to define
+
+static void sprite (int cmd, int n, uint32_t a, int b)
+    {
+    const char *psErr;
+    switch (cmd)
+        {
+        case 0:
+            sprw = a & 0xFFFF;
+            sprh = a >> 16;
+            sprkey = b;
+            break;
+        case 1:
+            psErr = sprdef (n, sprw, sprh, sprkey, (const uint8_t *)(uintptr_t) a);
+            if ( psErr ) error (255, psErr);
+            break;
+        case 2:
+            if ( b > 4 ) b = 0;
+            sprshow (n, gxscale ((int16_t)(a & 0xFFFF) + origx),
+                gyscale ((int16_t)(a >> 16) + origy), b);
+            break;
+        case 3:
+            sprhide (n);
+            break;
+        case 4:
+            sprclear ();
+            break;
+        }
+    }
+
+static void sprvdu (int cmd, int n, uint32_t a, int b)
+    {
+    xeqvdu (0x1700, (a >> 8) | ((uint32_t) b << 24), 27 | (cmd << 8) | (n << 16) | (a << 24));
+    }
+
+// SYS interface to the sprite commands:
+void sprite_define (int n, int w, int h, int key, const void *bits)
+    {
+    sprvdu (0, n, ( w & 0xFFFF ) | ((uint32_t) h << 16 ), key);
+    sprvdu (1, n, (uintptr_t) bits, 0);
+    }
+
+void sprite_show (int n, int x, int y, int op)
+    {
+    sprvdu (2, n, ( x & 0xFFFF ) | ((uint32_t) y << 16 ), op);
+    }
+
+void sprite_hide (int n)
+    {
+    sprvdu (3, n, 0, 0);
+    }
+
+void sprite_clear (void)
+    {
+    sprvdu (4, 0, 0, 0);
+    }
+
 // 0x17 - DEFINE CHARACTER ETC.
 static void vdu_23 (int code, int data1, int data2)
     {
@@ -2298,6 +2521,11 @@ static void vdu_23 (int code, int data1, int data2)
         uint8_t b = (data2 >> 16) & 0xFF;
         cmcflg = (cmcflg & b) ^ a;
         }
+    else if ( vdu == 27 )
+        {
+        sprite ((data2 >> 8) & 0xFF, (data2 >> 16) & 0xFF,
+            ((data2 >> 24) & 0xFF) | ((uint32_t) data1 << 8), (data1 >> 24) & 0xFF);
+        }
     else if ( vdu >= 32 )
         {
         defchr (vdu, (data2 >> 8) & 0xFF, (data2 >> 16) & 0xFF,
@@ -2430,7 +2658,11 @@ static const VDU_FUNC vdu_func[] =
     };
     
 
+#ifdef VDU_CORE1
+static void vduexec (int code, int data1, int data2)
+#else
 void xeqvdu (int code, int data1, int data2)
+#endif
     {
     int vdu = code >> 8;
 
@@ -2439,7 +2671,7 @@ void xeqvdu (int code, int data1, int data2)
     else if ((vdu == 10) || (vdu == 13)) printf ("%c", vdu);
     else if (vdu == 32) printf ("_");
     else printf (" 0x%02X ", vdu);
-    fflush (stdout);
+    conflush ();
 #endif
 
 #if REF_MODE > 0
@@ -2500,9 +2732,165 @@ void xeqvdu (int code, int data1, int data2)
     showcsr ();
     textx = 8 * xcsr;
     texty = pmode->thgt * ycsr;
-    if ( bPrint ) fflush (stdout);
     }
 
+#ifdef VDU_CORE1
+/*  VDU commands issued by the interpreter on core 0 are passed through a
+    single-producer / single-consumer ring to a worker on core 1, so that
+    drawing overlaps execution of the BASIC program. The interpreter only
+    waits if the ring is full, or at a fence before reading display state
+    (POS, VPOS, POINT, TINT, GET$(x,y), copy editing and star commands).
+    The tail index is only advanced once a command has completed, so an
+    empty ring means the display is up to date.
+
+    Only core 0 reads the keyboard, so a paged mode wait reached on core 1 is
+    passed back to core 0, which services it while waiting for the ring. The
+    cursor is flashed on core 0, and only when the ring is empty.
+
+    VDU_CORE1 = log2 of ring size
+*/
+#if ( VDU_CORE1 < 4 ) || ( VDU_CORE1 > 12 )
+#error VDU_CORE1 must be the log2 of the VDU command ring size, from 4 to 12
+#endif
+#define VDU_RSIZE   (1 << VDU_CORE1)
+
+typedef struct
+    {
+    int     code;
+    int     data1;
+    int     data2;
+    } VDUCMD;
+
+static VDUCMD vduring[VDU_RSIZE];
+static volatile uint32_t vduhead = 0;   // Written only by core 0
+static volatile uint32_t vdutail = 0;   // Written only by core 1
+static volatile int vduerrno = 0;       // Error raised by core 1
+static const char * volatile vduerrmsg = NULL;
+static volatile bool bPageWait = false;   // Core 1 waiting for core 0 to end a page
+static jmp_buf vdujmp;
+static bool bVduCore1 = false;
+
+static void vduerror (int iErr, const char *psErr)
+    {
+    if ( get_core_num () == 0 ) (error) (iErr, psErr);
+    vduerrmsg = psErr;
+    vduerrno = iErr;
+    // Discard the failing command and any that follow it
+    __mem_fence_release ();
+    vdutail = vduhead;
+    __sev ();
+    longjmp (vdujmp, 1);
+    }
+
+// Called on core 1 in paged mode: wait for core 0 to get a key:
+static void vdupagewait (void)
+    {
+    bPageWait = true;
+    __sev ();
+    while ( bPageWait ) __wfe ();
+    }
+
+// Called on core 0 while waiting for core 1:
+static void vduservice (void)
+    {
+    if ( bPageWait )
+        {
+        pagewait ();
+        bPageWait = false;
+        __sev ();
+        }
+    }
+
+// Before reading the keyboard in paged mode, complete any page wait for
+// output already queued, so that the page wait gets the key first:
+void vdupaged (void)
+    {
+    if (( bVduCore1 ) && ( scroln & 0x80 )) vdufence ();
+    }
+
+// Cursor flash from the periodic task, which runs on core 0. Core 1 is only
+// drawing while the ring holds commands, and core 0 cannot queue another
+// while this runs:
+void vduflashcsr (void)
+    {
+    if (( bVduCore1 ) && ( vdutail != vduhead )) return;
+    __mem_fence_acquire ();
+    flashcsr ();
+    }
+
+// Report any error raised by core 1:
+static void vducheck (void)
+    {
+    if ( vduerrno )
+        {
+        int iErr = vduerrno;
+        vduerrno = 0;
+        (error) (iErr, vduerrmsg);
+        }
+    }
+
+static void vduworker (void)
+    {
+    multicore_lockout_victim_init ();
+    setjmp (vdujmp);
+    while (true)
+        {
+        uint32_t tail = vdutail;
+        while ( tail == vduhead ) __wfe ();
+        __mem_fence_acquire ();
+        VDUCMD *pcmd = &vduring[tail & (VDU_RSIZE - 1)];
+        vduexec (pcmd->code, pcmd->data1, pcmd->data2);
+        __mem_fence_release ();
+        vdutail = tail + 1;
+        __sev ();
+        }
+    }
+
+// Wait until all queued VDU commands have been executed:
+void vdufence (void)
+    {
+    if (( ! bVduCore1 ) || ( get_core_num () != 0 )) return;
+    while ( vdutail != vduhead )
+        {
+        vduservice ();
+        __wfe ();
+        }
+    __mem_fence_acquire ();
+    vducheck ();
+    }
+
+// Start the worker. Must be called before any use of the flash file system,
+// as core 1 has to be locked out while flash is written:
+void vdustart (void)
+    {
+    multicore_launch_core1 (vduworker);
+    bVduCore1 = true;
+    }
+
+void xeqvdu (int code, int data1, int data2)
+    {
+    if (( ! bVduCore1 ) || ( get_core_num () != 0 ))
+        {
+        vduexec (code, data1, data2);
+        return;
+        }
+    uint32_t head = vduhead;
+    while ( head - vdutail >= VDU_RSIZE )
+        {
+        vduservice ();
+        __wfe ();
+        }
+    VDUCMD *pcmd = &vduring[head & (VDU_RSIZE - 1)];
+    pcmd->code = code;
+    pcmd->data1 = data1;
+    pcmd->data2 = data2;
+    __mem_fence_release ();
+    vduhead = head + 1;
+    __sev ();
+    vducheck ();
+    }
+#endif
+
 bool txtmode (int code, int *pdata1, int *pdata2)
     {
     const MODE *pm = modeinfo(code & 0x7F);
@@ -2513,42 +2901,150 @@ bool txtmode (int code, int *pdata1, int *pdata2)
     }
 
 #if REF_MODE & 2
+/*  The VDU queue is a compact display list. Each command is stored as its VDU code
+    followed by only the parameter bytes that it takes. Consecutive PLOTs of the same
+    type are merged into one group: 25, plot type, number of points, then for each point
+    the change in X and Y from the previous point, zig-zag encoded in 7-bit groups, so
+    a short line takes two bytes rather than the twelve of an unencoded call.
+*/
+
+#define VDUQ_MAX    16      // Room for the largest queue entry
+
+static const uint8_t vduqlen[32] = {
+    0,   1,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   1,   2,   5,   0,   0,   1,   9,   8,   5,   0,   1,   4,   4,   0,   2 };
+
+static int vduqx;           // Last point in queued PLOT group
+static int vduqy;
+
+static inline uint8_t *vduqput (uint8_t *pq, int v)
+    {
+    unsigned int u = ((unsigned int) v << 1 ) ^ ( v >> 31 );
+    while ( u >= 0x80 )
+        {
+        *pq = u | 0x80;
+        ++pq;
+        u >>= 7;
+        }
+    *pq = u;
+    return pq + 1;
+    }
+
+static inline const uint8_t *vduqget (const uint8_t *pq, int *pv)
+    {
+    unsigned int u = 0;
+    int sh = 0;
+    uint8_t b;
+    do
+        {
+        b = *pq;
+        ++pq;
+        u |= ( b & 0x7F ) << sh;
+        sh += 7;
+        }
+    while ( b & 0x80 );
+    *pv = ( u >> 1 ) ^ ( - ( u & 1 ));
+    return pq;
+    }
+
 void vduflush (void)
     {
     char resave = reflag;
     reflag = 2;
-    int *queptr = vduqbot;
+    const uint8_t *queptr = vduqbot;
 #if DEBUG & 4
     printf ("vduflush: libtop = %p, queptr = %p, vduque = %p\n", libtop, queptr, vduque);
 #endif
+    hlbatch (true);
     while ( queptr < vduque )
         {
-        int code = *(queptr);
-        int data1 = *(++queptr);
-        int data2 = *(++queptr);
+        int vdu = *queptr;
         ++queptr;
-        xeqvdu (code, data1, data2);
+        if ( vdu == 25 )
+            {
+            int type = queptr[0];
+            int npt = queptr[1];
+            int xp = 0;
+            int yp = 0;
+            queptr += 2;
+            while ( npt > 0 )
+                {
+                int dx, dy;
+                queptr = vduqget (queptr, &dx);
+                queptr = vduqget (queptr, &dy);
+                xp = ( xp + dx ) & 0xFFFF;
+                yp = ( yp + dy ) & 0xFFFF;
+                xeqvdu (0x1900 | ( yp >> 8 ), type | ( xp << 8 ) | ((unsigned int) yp << 24 ), 0);
+                --npt;
+                }
+            }
+        else
+            {
+            int code = vdu << 8;
+            int data1 = 0;
+            int data2 = 0;
+            for (int n = ( vdu < 32 ) ? vduqlen[vdu] : 0; n > 0; --n)
+                {
+                data2 = ((unsigned int) data2 >> 8 ) | ((unsigned int) data1 << 24 );
+                data1 = ((unsigned int) data1 >> 8 ) | ((unsigned int)( code & 0xFF ) << 24 );
+                code = ( code & 0xFF00 ) | *queptr;
+                ++queptr;
+                }
+            xeqvdu (code, data1, data2);
+            }
         }
+    hlbatch (false);
 #if DEBUG & 4
     printf ("vduflush: completed\n");
 #endif
     vduque = vduqbot;
+    vduqplt = NULL;
     reflag = resave;
     }
 
 void vduqueue (int code, int data1, int data2)
     {
-    if ( vduque >= vduqtop )
+    if ( vduque > vduqtop - VDUQ_MAX )
         {
 #if DEBUG & 4
         printf ("Flush due to queue full\n");
 #endif
         vduflush ();
         }
-    *vduque = code;
-    *(++vduque) = data1;
-    *(++vduque) = data2;
+    int vdu = ( code >> 8 ) & 0xFF;
+    if ( vdu == 25 )
+        {
+        int type = data1 & 0xFF;
+        int xp = ( data1 >> 8 ) & 0xFFFF;
+        int yp = (( data1 >> 24 ) & 0xFF ) | (( code & 0xFF ) << 8 );
+        if (( vduqplt == NULL ) || ( vduqplt[1] != type ) || ( vduqplt[2] == 0xFF ))
+            {
+            vduqplt = vduque;
+            vduqplt[0] = 25;
+            vduqplt[1] = type;
+            vduqplt[2] = 0;
+            vduque += 3;
+            vduqx = 0;
+            vduqy = 0;
+            }
+        ++vduqplt[2];
+        vduque = vduqput (vduque, (int16_t)( xp - vduqx ));
+        vduque = vduqput (vduque, (int16_t)( yp - vduqy ));
+        vduqx = xp;
+        vduqy = yp;
+        return;
+        }
+    *vduque = vdu;
     ++vduque;
+    // Parameters are stored first to last, last being in the low byte of code:
+    for (int n = ( vdu < 32 ) ? vduqlen[vdu] : 0; n > 0; --n)
+        {
+        if ( n > 5 )        *vduque = data2 >> ( 8 * ( 9 - n ));
+        else if ( n > 1 )   *vduque = data1 >> ( 8 * ( 5 - n ));
+        else                *vduque = code;
+        ++vduque;
+        }
+    vduqplt = NULL;
     }
 
 void vduqinit (void)
@@ -2556,15 +3052,15 @@ void vduqinit (void)
     void *sp = &sp;
     if ( libase - himem >= 12 * nRefQue + 4)
         {
-        vduqbot = (int *)(((int)himem + 3) & 0xFFFFFFFC);
-        vduqtop = vduqbot + nRefQue;
+        vduqbot = (uint8_t *)(((int)himem + 3) & 0xFFFFFFFC);
+        vduqtop = vduqbot + 12 * nRefQue;
         }
     else
         {
         if ( libase == 0 ) vduqbot = himem;
         else vduqbot = libtop;
-        vduqbot = (int *)(((int)vduqbot + 3) & 0xFFFFFFFC);
-        vduqtop = vduqbot + nRefQue;
+        vduqbot = (uint8_t *)(((int)vduqbot + 3) & 0xFFFFFFFC);
+        vduqtop = vduqbot + 12 * nRefQue;
         if ( (void *)vduqtop + 0x280 < sp )
             {
             libtop = vduqtop;
@@ -2575,6 +3071,8 @@ void vduqinit (void)
             error (255, "No room for refresh buffer");
             }
         }
+    vduque = vduqbot;
+    vduqplt = NULL;
     }
 
 void vduqterm (void)
@@ -2693,6 +3191,9 @@ void refresh (const char *p)
 #if defined(PICO_GUI) || defined(PICO_GRAPH)
 void copyedit (bool bEnable)
     {
+#ifdef VDU_CORE1
+    vdufence ();
+#endif
     if (bEnable)
         {
         if (xccsr == -1)
@@ -2718,6 +3219,9 @@ void copyedit (bool bEnable)
 
 void copymove (int key)
     {
+#ifdef VDU_CORE1
+    vdufence ();
+#endif
     hidecsr ();
     switch (key)
         {
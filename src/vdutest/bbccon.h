@@ -0,0 +1,27 @@
+/*  bbccon.h - Minimal stand-in for the BBCSDL header of the same name, with
+    just enough declarations to compile vducmd.c on the host for testing */
+
+#ifndef BBCCON_H
+#define BBCCON_H
+
+#include <stdint.h>
+
+typedef uint32_t heapptr;
+
+#define ESCFLG  0x80
+#define KILL    0x40
+
+#define VDUDIS  0x80
+#define HRGFLG  0x20
+
+extern unsigned char vflags;
+extern unsigned char flags;
+extern unsigned char cmcflg;
+extern unsigned char scroln;
+extern unsigned char modeno;
+extern char reflag;
+extern char *usrchr;
+extern void *userRAM;
+extern uint8_t bbcfont[];
+
+#endif
@@ -0,0 +1,289 @@
+/*  ellipse_ref.c - The ellipse and arc rasteriser as it was before the edges were
+    stepped incrementally, kept as the reference for ellipse_test.c. It is included
+    after vducmd.c, and uses that file's state and drawing primitives.
+
+    The one change from the original is the range check in the per-row search
+    of ellipse_ref(), which compared an unsigned wrapped value and left short
+    spans on some rows of filled circles.
+*/
+
+static void ellipse_ref (bool bFill, int clrop, int xc, int yc, uint32_t aa, uint32_t bb, uint64_t dd)
+    {
+    uint32_t xp = pmode->gcol;
+    uint32_t yp = 0;
+    uint32_t xl = 0;
+    int dx = 0;
+    while ( true )
+        {
+        uint32_t sq = yp * yp;
+        uint64_t pp = ((uint64_t) bb) * ((uint64_t) sq);
+        if ( pp > dd ) break;
+        uint64_t qq = dd - pp;
+        sq = xp * xp;
+        pp = ((uint64_t) aa) * ((uint64_t) sq);
+        if ( pp > qq )
+            {
+            int x1 = 0;
+            int x2 = xp;
+            while ( x2 - x1 > 1 )
+                {
+                if ( dx > 0 )
+                    {
+                    xp = x2 - dx;
+                    dx *= 2;
+                    // Was ( xp < x1 ): unsigned, so a wrapped x2 - dx passed the check
+                    if ( (int) xp < x1 )
+                        {
+                        xp = ( x1 + x2 ) / 2;
+                        dx = 0;
+                        }
+                    }
+                else
+                    {
+                    xp = ( x1 + x2 ) / 2;
+                    }
+                sq = xp * xp;
+                pp = ((uint64_t) aa) * ((uint64_t) sq);
+                if ( pp > qq )
+                    {
+                    x2 = xp;
+                    }
+                else if ( pp == qq )
+                    {
+                    x1 = xp;
+                    break;
+                    }
+                else
+                    {
+                    x1 = xp;
+                    dx = 0;
+                    }
+                }
+            xp = x1;
+            }
+        if ( yp == 0 )
+            {
+            if ( bFill )
+                {
+                hdraw (clrop, xc - xp, xc + xp, yc + yp);
+                }
+            dx = 1;
+            }
+        else if ( bFill )
+            {
+            hdraw (clrop, xc - xp, xc + xp, yc + yp);
+            hdraw (clrop, xc - xp, xc + xp, yc - yp);
+            }
+        else if ( xp == xl )
+            {
+            clippoint (clrop, xc + xl, yc + yp - 1);
+            clippoint (clrop, xc - xl, yc + yp - 1);
+            if ( yp > 1 )
+                {
+                clippoint (clrop, xc + xl, yc - yp + 1);
+                clippoint (clrop, xc - xl, yc - yp + 1);
+                }
+            }
+        else
+            {
+            hdraw (clrop, xc + xp + 1, xc + xl, yc + yp - 1);
+            hdraw (clrop, xc - xl, xc - xp - 1, yc + yp - 1);
+            if ( yp > 1 )
+                {
+                hdraw (clrop, xc + xp + 1, xc + xl, yc - yp + 1);
+                hdraw (clrop, xc - xl, xc - xp - 1, yc - yp + 1);
+                }
+            }
+        dx = xl - xp;
+        if ( dx <= 0 ) dx = 1;
+        xl = xp;
+        ++yp;
+        }
+    if ( ! bFill )
+        {
+        hdraw (clrop, xc - xl, xc + xl, yc + yp - 1);
+        if ( yp > 1 )
+            hdraw (clrop, xc - xl, xc + xl, yc - yp + 1);
+        }
+    }
+
+static void plotcir_ref (bool bFill, int clrop)
+    {
+    int xd = pltpt[0].x - pltpt[1].x;
+    int yd = pltpt[0].y - pltpt[1].y;
+    int r2 = xd * xd + yd * yd;
+    if ( r2 < 4 ) clippoint (clrop, pltpt[1].x >> xshift, pltpt[1].y >> yshift);
+    else ellipse_ref (bFill, clrop, pltpt[1].x >> xshift, pltpt[1].y >> yshift,
+        pixelx << xshift, pixely << yshift, r2);
+    }
+
+static void plotellipse_ref (bool bFill, int clrop)
+    {
+    int xc = pltpt[2].x >> xshift;
+    int yc = pltpt[2].y >> yshift;
+    int xa = pltpt[1].x - pltpt[2].x;
+    int yb = pltpt[0].y - pltpt[2].y;
+    if ( xa < 0 ) xa = - xa;
+    if ( yb < 0 ) yb = - yb;
+    if (( xa < pixelx ) && ( yb < pixely ))
+        {
+        clippoint (clrop, xc, xc);
+        }
+    else if ( yb < pixely )
+        {
+        xa >>= xshift;
+        hdraw (clrop, xc - xa, xc + xa, yc);
+        }
+    else if ( xa < 2 )
+        {
+        yb >>= yshift;
+        clipline (clrop, xc, yc - yb, xc, yc + yb, 0xFFFFFFFF, SKIP_NONE);
+        }
+    else
+        {
+        xa *= xa;
+        yb *= yb;
+        uint64_t dd = ((uint64_t) xa) * ((uint64_t) yb);
+        xa <<= 2 * yshift;
+        yb <<= 2 * xshift;
+        ellipse_ref (bFill, clrop, xc, yc, yb, xa, dd);
+        }
+    }
+
+static void arc_ref (int clrop)
+    {
+    int xc = pltpt[2].x >> xshift;
+    int yc = pltpt[2].y >> yshift;
+    int xp = pltpt[1].x - pltpt[2].x;
+    int yp = pltpt[2].y - pltpt[1].y;
+    int xe = pltpt[0].x - pltpt[2].x;
+    int ye = pltpt[2].y - pltpt[0].y;
+    int r2 = xp * xp + yp * yp;
+    int s1 = iroot (r2 << 8);
+    int s2 = iroot ((xe * xe + ye * ye) << 8);
+    xe = xe * s1 / s2;
+    ye = ye * s1 / s2;
+    pltpt[0].x = pltpt[2].x + xe;
+    pltpt[0].y = pltpt[2].y - ye;
+    int iOct = octant (xp, yp);
+    int iEnd = octant (xe, ye);
+    if ( iEnd < iOct )
+        {
+        iEnd += 8;
+        }
+    else if ( iEnd == iOct )
+        {
+        switch (iOct)
+            {
+            case 0:
+                if ( ye < yp ) iEnd += 8;
+                break;
+            case 1:
+            case 2:
+                if ( xe > xp ) iEnd += 8;
+                break;
+            case 3:
+            case 4:
+                if ( ye > yp ) iEnd += 8;
+                break;
+            case 5:
+            case 6:
+                if ( xe < xp ) iEnd += 8;
+                break;
+            case 7:
+                if ( ye < yp ) iEnd += 8;
+                break;
+            }
+        }
+    bool bDone = false;
+    xp >>= xshift;
+    yp >>= yshift;
+    xe >>= xshift;
+    ye >>= yshift;
+    int xs = 2 * xshift;
+    int ys = 2 * yshift;
+    while (! bDone)
+        {
+        clippoint (clrop, xc + xp, yc - yp);
+        switch (iOct & 0x07)
+            {
+            case 0:
+                ++yp;
+                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) --xp;
+                if ( (yp << ys) >= (xp << xs) )
+                    {
+                    ++iOct;
+                    }
+                if (( iOct >= iEnd ) && ( yp > ye )) bDone = true;
+                break;
+            case 1:
+                --xp;
+                ++yp;
+                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) --yp;
+                if ( xp <= 0 )
+                    {
+                    ++iOct;
+                    }
+                if (( iOct >= iEnd ) && ( xp < xe )) bDone = true;
+                break;
+            case 2:
+                --xp;
+                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) --yp;
+                if ( (yp << ys) <= ((-xp) << xs) )
+                    {
+                    ++iOct;
+                    }
+                if (( iOct >= iEnd ) && ( xp < xe )) bDone = true;
+                break;
+            case 3:
+                --yp;
+                --xp;
+                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) ++xp;
+                if ( yp <= 0 )
+                    {
+                    ++iOct;
+                    }
+                if (( iOct >= iEnd ) && ( yp < ye )) bDone = true;
+                break;
+            case 4:
+                --yp;
+                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) ++xp;
+                if ( (yp << ys) <= (xp << xs) )
+                    {
+                    ++iOct;
+                    }
+                if (( iOct >= iEnd ) && ( yp < ye )) bDone = true;
+                break;
+            case 5:
+                ++xp;
+                --yp;
+                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) ++yp;
+                if ( xp >= 0 )
+                    {
+                    ++iOct;
+                    }
+                if (( iOct >= iEnd ) && ( xp > xe )) bDone = true;
+                break;
+            case 6:
+                ++xp;
+                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) ++yp;
+                if ( (xp << xs) >= ((-yp) << ys) )
+                    {
+                    ++iOct;
+                    }
+                if (( iOct >= iEnd ) && ( xp > xe )) bDone = true;
+                break;
+            case 7:
+                ++yp;
+                ++xp;
+                if ( ((xp * xp) << xs) + ((yp * yp) << ys) > r2 ) --xp;
+                if ( yp >= 0 )
+                    {
+                    ++iOct;
+                    }
+                if (( iOct >= iEnd ) && ( yp > ye )) bDone = true;
+                break;
+            }
+        }
+    }
+
@@ -0,0 +1,151 @@
+/*  ellipse_test.c - Compare the circle, ellipse and arc rasteriser in vducmd.c with
+    the reference version in ellipse_ref.c, over a range of radii, axes and angles,
+    outline and filled, for each combination of graphics unit scales (xshift and
+    yshift 0 to 2). Every pixel must be plotted the same number of times by both.
+
+    Sectors and segments (PLOT 168 to 183) are not implemented in vducmd.c, so
+    there is nothing to compare for them */
+
+#include <math.h>
+#include "vdustub.h"
+#include "../vducmd.c"
+#include "ellipse_ref.c"
+
+static VDTGRID gref, gnew;
+static MODE mtest = { 4, VDT_W, VDT_H, VDT_W / 8, VDT_H / 8, 0, 0, 2, VDT_W / 2, 0, 8 };
+static int ncase = 0;
+static int nfail = 0;
+
+// Compare the result of the reference and new versions of the last shape drawn:
+static void check (const char *psShape, bool bFill, int r1, int r2, int a1, int a2)
+    {
+    int xp, yp;
+    int ndiff = vdt_compare (&gref, &gnew, &xp, &yp);
+    ++ncase;
+    if ( ndiff > 0 )
+        {
+        if ( ++nfail <= 20 )
+            printf ("%s%s (%d, %d, %d, %d) xshift = %d, yshift = %d: %d pixels differ, first at (%d, %d)\n",
+                bFill ? "Filled " : "", psShape, r1, r2, a1, a2, xshift, yshift, ndiff, xp, yp);
+        }
+    }
+
+// Set plot point n to (xc + dx, yc - dy) in graphics units:
+static void setpt (int n, int xc, int yc, int dx, int dy)
+    {
+    pltpt[n].x = xc + dx;
+    pltpt[n].y = yc - dy;
+    }
+
+static void circles (int xc, int yc)
+    {
+    for (int r = 0; r <= 700; r += ( r < 64 ) ? 1 : 7)
+        {
+        for (int a = 0; a < 90; a += 15)
+            {
+            int dx = lround (r * cos (a * M_PI / 180.0));
+            int dy = lround (r * sin (a * M_PI / 180.0));
+            for (int f = 0; f < 2; ++f)
+                {
+                setpt (1, xc, yc, 0, 0);
+                setpt (0, xc, yc, dx, dy);
+                vdt_grid = &gref;
+                plotcir_ref (f, 1);
+                setpt (1, xc, yc, 0, 0);
+                setpt (0, xc, yc, dx, dy);
+                vdt_grid = &gnew;
+                plotcir (f, 1);
+                check ("circle", f, r, 0, a, 0);
+                }
+            }
+        }
+    }
+
+static void ellipses (int xc, int yc)
+    {
+    static const int axes[] = { 0, 1, 2, 3, 4, 5, 7, 10, 16, 25, 40, 63, 100, 159, 250, 397, 630 };
+    const int naxes = sizeof (axes) / sizeof (axes[0]);
+    for (int i = 0; i < naxes; ++i)
+        {
+        for (int j = 0; j < naxes; ++j)
+            {
+            for (int f = 0; f < 2; ++f)
+                {
+                setpt (2, xc, yc, 0, 0);
+                setpt (1, xc, yc, axes[i], 0);
+                setpt (0, xc, yc, 0, axes[j]);
+                vdt_grid = &gref;
+                plotellipse_ref (f, 1);
+                vdt_grid = &gnew;
+                plotellipse (f, 1);
+                check ("ellipse", f, axes[i], axes[j], 0, 0);
+                }
+            }
+        }
+    }
+
+static void arcs (int xc, int yc)
+    {
+    static const int radii[] = { 2, 3, 5, 8, 13, 21, 34, 55, 89, 144, 233, 377 };
+    const int nradii = sizeof (radii) / sizeof (radii[0]);
+    for (int i = 0; i < nradii; ++i)
+        {
+        int r = radii[i];
+        for (int a1 = 0; a1 < 360; a1 += 15)
+            {
+            for (int a2 = 7; a2 < 360; a2 += 15)
+                {
+                int dx1 = lround (r * cos (a1 * M_PI / 180.0));
+                int dy1 = lround (r * sin (a1 * M_PI / 180.0));
+                // The end point need not be on the circle: arc() scales it
+                int dx2 = lround (2 * r * cos (a2 * M_PI / 180.0));
+                int dy2 = lround (2 * r * sin (a2 * M_PI / 180.0));
+                setpt (2, xc, yc, 0, 0);
+                setpt (1, xc, yc, dx1, dy1);
+                setpt (0, xc, yc, dx2, dy2);
+                vdt_grid = &gref;
+                arc_ref (1);
+                setpt (2, xc, yc, 0, 0);
+                setpt (1, xc, yc, dx1, dy1);
+                setpt (0, xc, yc, dx2, dy2);
+                vdt_grid = &gnew;
+                arc (1);
+                check ("arc", false, r, 0, a1, a2);
+                }
+            }
+        }
+    }
+
+int main (int argc, char *argv[])
+    {
+    pmode = &mtest;
+    gvl = 0;
+    gvr = VDT_W - 1;
+    gvt = 0;
+    gvb = VDT_H - 1;
+    vdt_clear (&gref, 0);
+    vdt_clear (&gnew, 0);
+    for (xshift = 0; xshift <= 2; ++xshift)
+        {
+        for (yshift = 0; yshift <= 2; ++yshift)
+            {
+            pixelx = 1 << xshift;
+            pixely = 1 << yshift;
+            // Centred, and near a corner so that the shapes are clipped
+            int xc = ( VDT_W / 2 ) << xshift;
+            int yc = ( VDT_H / 2 ) << yshift;
+            circles (xc, yc);
+            ellipses (xc, yc);
+            arcs (xc, yc);
+            xc = 20 << xshift;
+            yc = ( VDT_H - 30 ) << yshift;
+            circles (xc, yc);
+            ellipses (xc, yc);
+            arcs (xc, yc);
+            }
+        }
+    if ( vdt_nerr > 0 )
+        printf ("%d drawing calls outside the screen\n", vdt_nerr);
+    printf ("%d shapes compared, %d differ\n", ncase, nfail);
+    return (( nfail > 0 ) || ( vdt_nerr > 0 )) ? 1 : 0;
+    }
@@ -0,0 +1,79 @@
+/*  flood_ref.c - The flood fill as it was before the scanline span fill, kept as the
+    reference for flood_test.c: the cursor walk alone, with its original left cycle
+    test and stopping rule. It is included after vducmd.c, and uses that file's
+    cursor movement and criticality test, which are unchanged.
+
+    The one change from the original is a limit on the number of cursor steps, as the
+    walk can run on indefinitely for some regions. A fill that reaches the limit stops
+    with an error, and is counted by the test rather than compared. The set of colours
+    to fill, which doflood now uses, is every colour fillclr accepts, as it was.
+*/
+
+static long nrefstep;
+static long nrefmax;
+
+static void refstep (void)
+    {
+    if ( ++nrefstep > nrefmax ) error (255, "Fill too long");
+    }
+
+static int FCurLeft_ref (int iDir, int iW)
+    {
+    if ( ( iW & 0x0AA ) == 0x0AA ) error (255, "Fill stuck");
+    iDir = ( iDir + 3 ) & 3;
+    while ( iW & iDirMask[iDir] ) iDir = ( iDir + 1 ) & 3;
+    return iDir;
+    }
+
+static bool LeftCycle_ref (FILLINFO *pfi, int iXC, int iYC, int iDC, int iW)
+    {
+    iDC = FCurLeft_ref (iDC, iW);
+    int iX = iXC;
+    int iY = iYC;
+    int iDir = iDC;
+    FCurMove (pfi, iDir, &iX, &iY, &iW);
+    while (( iX != iXC ) || ( iY != iYC ))
+        {
+        refstep ();
+        if ( ! FCurCrit (iW) ) iW = FCurSet (pfi, iX, iY, iW);
+        iDir = FCurLeft_ref (iDir, iW);
+        FCurMove (pfi, iDir, &iX, &iY, &iW);
+        }
+    iDir = FCurLeft_ref (iDir, iW);
+    return ( iDir == iDC );
+    }
+
+static void flood_ref (bool bEq, uint8_t tclr, int clrop, int iX, int iY)
+    {
+    FILLINFO fi;
+    fi.clrop = clrop;
+    fi.bEq = bEq;
+    fi.tclr = tclr;
+    fi.inset = 0;
+    for (int i = 0; i <= cmsk; ++i)
+        if ( fillclr (&fi, i) ) fi.inset |= 1 << i;
+    nrefstep = 0;
+    nrefmax = 100L * ( gvr - gvl + 1 ) * ( gvb - gvt + 1 );
+    int iDir = 0;
+    int iW;
+    FillInit (&fi, &iX, &iY, &iW);
+    while (true)
+        {
+        refstep ();
+        if ( ( iW & 0x1EF ) == 0x1EF )
+            {
+            iW = FCurSet (&fi, iX, iY, iW);
+            return;
+            }
+        if ( FCurCrit (iW) )
+            {
+            if ( LeftCycle_ref (&fi, iX, iY, iDir, iW) ) iW |= 0x010;
+            }
+        else
+            {
+            iW = FCurSet (&fi, iX, iY, iW);
+            }
+        iDir = FCurRight (iDir, iW);
+        FCurMove (&fi, iDir, &iX, &iY, &iW);
+        }
+    }
@@ -0,0 +1,338 @@
+/*  flood_test.c - Compare the flood fill in vducmd.c (scanline spans, falling back to
+    the cursor walk when the span stack is full) with the fill it replaced, the cursor
+    walk alone (flood_ref.c), and with a plain search for the 4-connected region of
+    pixels to be filled.
+
+    Scenes of random noise, rectangles and combs are filled from random seed points,
+    in 2, 4 and 16 colour modes, with and without a graphics viewport, for both kinds
+    of fill (to a colour and to a boundary) and all the plotting actions. Every fill
+    is compared with the region search, which expects each pixel to be plotted once.
+    For exclusive-or and invert, colours which plotting would leave still to be
+    filled are not filled.
+
+    The old fill misses parts of some regions, stops with "Fill stuck" on others, and
+    can run on indefinitely. Where it differs from the new fill, it must also differ
+    from the region search. It is compared by pixel colour alone, as it sometimes
+    plots a pixel more than once.
+
+    Built twice: flood_test with the normal span stack, and flood_small with a stack
+    of a few spans, so that many fills overflow it and are completed by the walk.
+    The walk is slow on large regions of noise, so flood_small uses only the top left
+    of the screen */
+
+#include <time.h>
+#include "vdustub.h"
+#include "../vducmd.c"
+#include "flood_ref.c"
+
+#ifndef NSCENE
+#define NSCENE  20      // Scenes in each mode
+#endif
+#ifndef VPW
+#define VPW     VDT_W   // Size of the part of the screen used
+#endif
+#ifndef VPH
+#define VPH     VDT_H
+#endif
+
+static VDTGRID gscene, gexp, gref, gnew;
+static MODE mtest = { 4, VDT_W, VDT_H, VDT_W / 8, VDT_H / 8, 0, 0, 2, VDT_W / 2, 0, 8 };
+static bool bDone[VDT_H][VDT_W];
+static int queue[VDT_W * VDT_H];
+static int ncase = 0;           // Fills compared with the region search
+static int nfail = 0;           // Fills differing from the region search
+static int nnewerr = 0;         // New fill stopped with an error
+static int nwalk = 0;           // Span fills which overflowed and used the cursor walk
+static int nrefcmp = 0;         // Fills compared with the old fill
+static int nrefdiff = 0;        // Fills differing from the old fill
+static int nrefbad = 0;         // ... where the old fill matched the region search
+static int nrefstuck = 0;       // Old fill stopped with "Fill stuck"
+static int nreflong = 0;        // Old fill stopped at the step limit
+static clock_t tnew = 0;        // Time for fills completed by both versions, without the walk
+static clock_t tref = 0;
+static clock_t twalk = 0;       // Time for fills which used the walk
+static uint32_t seed = 12345;
+
+static uint32_t rnd (uint32_t n)
+    {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed % n;
+    }
+
+/*  Number of pixels differing in colour (and if bCnt is set, in plot count), and the
+    position of the first */
+static int diff (VDTGRID *pg1, VDTGRID *pg2, bool bCnt, int *px, int *py)
+    {
+    int ndiff = 0;
+    for (int yp = 0; yp < VDT_H; ++yp)
+        {
+        if (( memcmp (pg1->clr[yp], pg2->clr[yp], VDT_W) == 0 )
+            && (( ! bCnt ) || ( memcmp (pg1->cnt[yp], pg2->cnt[yp], sizeof (pg1->cnt[yp])) == 0 ))) continue;
+        for (int xp = 0; xp < VDT_W; ++xp)
+            {
+            if (( pg1->clr[yp][xp] != pg2->clr[yp][xp] )
+                || ( bCnt && ( pg1->cnt[yp][xp] != pg2->cnt[yp][xp] )))
+                {
+                if ( ndiff++ == 0 )
+                    {
+                    *px = xp;
+                    *py = yp;
+                    }
+                }
+            }
+        }
+    return ndiff;
+    }
+
+// Colour of a pixel of colour pclr after plotting with a GCOL action:
+static uint8_t plotclr (int clrop, uint8_t pclr)
+    {
+    uint8_t clr = clrop & cmsk;
+    switch ( clrop >> 8 )
+        {
+        case 1: return pclr | clr;
+        case 2: return pclr & clr;
+        case 3: return pclr ^ clr;
+        case 4: return ~ pclr & cmsk;
+        default: return clr;
+        }
+    }
+
+// Apply a GCOL action to a single pixel of the expected result:
+static void setexp (int clrop, int xp, int yp)
+    {
+    gexp.clr[yp][xp] = plotclr (clrop, gexp.clr[yp][xp]);
+    ++gexp.cnt[yp][xp];
+    }
+
+/*  Colours to be filled: those fillclr accepts, less any which plotting would leave
+    still accepted (possible for exclusive-or and invert), as those are not filled */
+static void fillset (FILLINFO *pfi)
+    {
+    uint32_t inset = 0;
+    for (int i = 0; i <= cmsk; ++i)
+        if ( fillclr (pfi, i) ) inset |= 1 << i;
+    pfi->inset = 0;
+    for (int i = 0; i <= cmsk; ++i)
+        if (( inset & ( 1 << i )) && !( inset & ( 1 << plotclr (pfi->clrop, i) ))) pfi->inset |= 1 << i;
+    }
+
+// Expected result: every pixel 4-connected to the seed which is to be filled, filled once
+static void search (FILLINFO *pfi, int xp, int yp)
+    {
+    static const int dxy[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+    memcpy (&gexp, &gscene, sizeof (gexp));
+    memset (bDone, 0, sizeof (bDone));
+    vdt_grid = &gexp;
+    int nq = 0;
+    queue[nq++] = yp * VDT_W + xp;
+    bDone[yp][xp] = true;
+    for (int iq = 0; iq < nq; ++iq)
+        {
+        int x = queue[iq] % VDT_W;
+        int y = queue[iq] / VDT_W;
+        for (int i = 0; i < 4; ++i)
+            {
+            int x2 = x + dxy[i][0];
+            int y2 = y + dxy[i][1];
+            if (( x2 < gvl ) || ( x2 > gvr ) || ( y2 < gvt ) || ( y2 > gvb ) || bDone[y2][x2] ) continue;
+            if ( doflood (pfi, x2, y2) )
+                {
+                bDone[y2][x2] = true;
+                queue[nq++] = y2 * VDT_W + x2;
+                }
+            }
+        }
+    for (int iq = 0; iq < nq; ++iq) setexp (pfi->clrop, queue[iq] % VDT_W, queue[iq] / VDT_W);
+    }
+
+// Run one of the fills on a copy of the scene; false if it stopped with an error:
+static bool dofill (VDTGRID *pg, bool bNew, FILLINFO *pfi, int xp, int yp, clock_t *pt)
+    {
+    jmp_buf jb;
+    memcpy (pg, &gscene, sizeof (*pg));
+    vdt_grid = pg;
+    vdt_catch = &jb;
+    vdt_errmsg = NULL;
+    clock_t t0 = clock ();
+    if ( setjmp (jb) != 0 )
+        {
+        vdt_catch = NULL;
+        return false;
+        }
+    if ( bNew ) flood (pfi->bEq, pfi->tclr, pfi->clrop, xp, yp);
+    else flood_ref (pfi->bEq, pfi->tclr, pfi->clrop, xp, yp);
+    vdt_catch = NULL;
+    *pt = clock () - t0;
+    return true;
+    }
+
+static void report (const char *psWhat, int ndiff, FILLINFO *pfi, int xp, int yp, int xd, int yd)
+    {
+    printf ("%s: cmsk = %d, viewport (%d, %d) - (%d, %d), %s 0x%02X, clrop = 0x%03X, "
+        "from (%d, %d): %d pixels differ, first at (%d, %d)\n", psWhat, cmsk, gvl, gvt, gvr, gvb,
+        pfi->bEq ? "fill colour" : "to boundary", pfi->tclr, pfi->clrop, xp, yp, ndiff, xd, yd);
+    }
+
+// Fill the current scene from a random seed point, and compare the results:
+static void fillcase (int action)
+    {
+    FILLINFO fi;
+    int xp, yp;
+    vdt_grid = &gscene;
+    for (int i = 0; i < 100; ++i)
+        {
+        xp = gvl + rnd (gvr - gvl + 1);
+        yp = gvt + rnd (gvb - gvt + 1);
+        fi.bEq = ( rnd (2) == 0 );
+        fi.tclr = gscene.clr[yp][xp];
+        if ( ! fi.bEq )
+            while ( fi.tclr == gscene.clr[yp][xp] ) fi.tclr = rnd (cmsk + 1);
+        fi.clrop = ( action << 8 ) | rnd (cmsk + 1);
+        fillset (&fi);
+        if ( doflood (&fi, xp, yp) ) break;
+        }
+    if ( ! doflood (&fi, xp, yp) ) return;
+    int xd = 0;
+    int yd = 0;
+    int ndiff;
+    int npoint = vdt_npoint;
+    clock_t t1, t2;
+    if ( ! dofill (&gnew, true, &fi, xp, yp, &t1) )
+        {
+        if ( ++nnewerr <= 20 ) report (vdt_errmsg, 0, &fi, xp, yp, 0, 0);
+        return;
+        }
+    bool bWalk = ( vdt_npoint > npoint );
+    if ( bWalk )
+        {
+        ++nwalk;
+        twalk += t1;
+        }
+    search (&fi, xp, yp);
+    ++ncase;
+    ndiff = diff (&gexp, &gnew, true, &xd, &yd);
+    if (( ndiff > 0 ) && ( ++nfail <= 20 ))
+        report ("Region search", ndiff, &fi, xp, yp, xd, yd);
+    if ( ! dofill (&gref, false, &fi, xp, yp, &t2) )
+        {
+        if ( strcmp (vdt_errmsg, "Fill stuck") == 0 ) ++nrefstuck;
+        else ++nreflong;
+        return;
+        }
+    ++nrefcmp;
+    if ( ! bWalk )
+        {
+        tnew += t1;
+        tref += t2;
+        }
+    ndiff = diff (&gref, &gnew, false, &xd, &yd);
+    if ( ndiff == 0 ) return;
+    ++nrefdiff;
+    if (( diff (&gref, &gexp, false, &xd, &yd) == 0 ) && ( ++nrefbad <= 20 ))
+        report ("Old fill", ndiff, &fi, xp, yp, xd, yd);
+    }
+
+// Random pixels, each of colour clr2 with probability pc percent, otherwise clr1
+static void noise (int pc, uint8_t clr1, uint8_t clr2)
+    {
+    for (int yp = 0; yp < VDT_H; ++yp)
+        for (int xp = 0; xp < VDT_W; ++xp)
+            gscene.clr[yp][xp] = ( rnd (100) < pc ) ? clr2 : clr1;
+    }
+
+// Pixels of random colours
+static void speckle (void)
+    {
+    for (int yp = 0; yp < VDT_H; ++yp)
+        for (int xp = 0; xp < VDT_W; ++xp)
+            gscene.clr[yp][xp] = rnd (cmsk + 1);
+    }
+
+// Random rectangles, outlined or solid, in random colours
+static void rectangles (int nrect)
+    {
+    memset (gscene.clr, rnd (cmsk + 1), sizeof (gscene.clr));
+    for (int i = 0; i < nrect; ++i)
+        {
+        int x1 = rnd (VDT_W);
+        int x2 = x1 + rnd (VDT_W - x1);
+        int y1 = rnd (VDT_H);
+        int y2 = y1 + rnd (VDT_H - y1);
+        uint8_t clr = rnd (cmsk + 1);
+        bool bSolid = ( rnd (4) == 0 );
+        for (int yp = y1; yp <= y2; ++yp)
+            for (int xp = x1; xp <= x2; ++xp)
+                if ( bSolid || ( xp == x1 ) || ( xp == x2 ) || ( yp == y1 ) || ( yp == y2 ) )
+                    gscene.clr[yp][xp] = clr;
+        }
+    }
+
+/*  Teeth one pixel wide, joined alternately at the top and bottom, with one tooth
+    in four broken. Filling along one end leaves a span to search for every tooth */
+static void comb (uint8_t clr1, uint8_t clr2)
+    {
+    memset (gscene.clr, clr1, sizeof (gscene.clr));
+    for (int xp = 1; xp < VDT_W; xp += 2)
+        {
+        int ygap = rnd (VDT_H);
+        bool bBroken = ( rnd (4) == 0 );
+        for (int yp = ( xp & 2 ) ? 1 : 0; yp < VDT_H - (( xp & 2 ) ? 0 : 1); ++yp)
+            if ( ! bBroken || ( yp != ygap ) ) gscene.clr[yp][xp] = clr2;
+        }
+    }
+
+static void scene (void)
+    {
+    uint8_t clr1 = rnd (cmsk + 1);
+    uint8_t clr2 = ( clr1 + 1 + rnd (cmsk) ) & cmsk;
+    switch ( rnd (5) )
+        {
+        case 0: noise (30 + rnd (35), clr1, clr2);  break;
+        case 1: noise (rnd (20), clr1, clr2);       break;
+        case 2: speckle ();                         break;
+        case 3: rectangles (1 + rnd (60));          break;
+        case 4: comb (clr1, clr2);                  break;
+        }
+    // Full screen, or a random viewport
+    if ( rnd (2) == 0 )
+        {
+        gvl = 0;
+        gvr = VPW - 1;
+        gvt = 0;
+        gvb = VPH - 1;
+        }
+    else
+        {
+        gvl = rnd (VPW);
+        gvr = gvl + rnd (VPW - gvl);
+        gvt = rnd (VPH);
+        gvb = gvt + rnd (VPH - gvt);
+        }
+    for (int i = 0; i < 4; ++i) fillcase (rnd (5));
+    }
+
+int main (int argc, char *argv[])
+    {
+    static const int ncbt[] = { 1, 2, 4 };
+    pmode = &mtest;
+    memset (gscene.cnt, 0, sizeof (gscene.cnt));
+    for (int m = 0; m < 3; ++m)
+        {
+        mtest.ncbt = ncbt[m];
+        cmsk = ( 1 << ncbt[m] ) - 1;
+        vdt_cmsk = cmsk;
+        for (int i = 0; i < NSCENE; ++i) scene ();
+        }
+    printf ("NFILLSPAN = %d: %d fills compared with the region search, %d differ, %d stopped with an error\n",
+        NFILLSPAN, ncase, nfail, nnewerr);
+    printf ("%d fills overflowed the span stack and were completed by the cursor walk, taking %.2f s\n",
+        nwalk, (double) twalk / CLOCKS_PER_SEC);
+    printf ("Old fill: %d stuck, %d stopped at the step limit; %d compared, %d differ, %d of them correctly\n",
+        nrefstuck, nreflong, nrefcmp, nrefdiff, nrefbad);
+    printf ("Time for the fills compared which did not overflow: new %.2f s, old %.2f s\n",
+        (double) tnew / CLOCKS_PER_SEC, (double) tref / CLOCKS_PER_SEC);
+    return (( nfail > 0 ) || ( nnewerr > 0 ) || ( nrefbad > 0 )) ? 1 : 0;
+    }
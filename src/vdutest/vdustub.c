@@ -0,0 +1,181 @@
+/*  vdustub.c - Host stand-ins for the display driver and the interpreter, so that
+    vducmd.c can be included in a test program */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "bbccon.h"
+#include "vducmd.h"
+#include "vdustub.h"
+
+VDTGRID *vdt_grid = NULL;
+int vdt_ymin = VDT_H;
+int vdt_ymax = -1;
+int vdt_nerr = 0;
+int vdt_npoint = 0;
+uint8_t vdt_cmsk = 0xFF;
+jmp_buf *vdt_catch = NULL;
+const char *vdt_errmsg = NULL;
+
+// Interpreter variables used by vducmd.c:
+unsigned char vflags;
+unsigned char flags;
+unsigned char cmcflg;
+unsigned char scroln;
+unsigned char modeno;
+char reflag;
+char *usrchr;
+void *userRAM;
+void *vpage;
+uint8_t bbcfont[0x800];
+int origx, origy, lastx, lasty, prevx, prevy;
+int pixelx = 1, pixely = 1;
+int textx, texty;
+short int forgnd, bakgnd;
+unsigned char txtfor, txtbak;
+
+// Console output, buffered by bbpico.c on the Pico:
+int conprintf (const char *psFmt, ...)
+    {
+    va_list va;
+    va_start (va, psFmt);
+    int n = vprintf (psFmt, va);
+    va_end (va);
+    return n;
+    }
+
+int conputc (int c)
+    {
+    return putchar (c);
+    }
+
+void conflush (void)
+    {
+    fflush (stdout);
+    }
+
+void error (int iErr, const char *psErr)
+    {
+    if ( vdt_catch )
+        {
+        vdt_errmsg = psErr;
+        longjmp (*vdt_catch, iErr);
+        }
+    printf ("error %d: %s\n", iErr, psErr ? psErr : "");
+    exit (2);
+    }
+
+// Clear a grid to colour clr:
+void vdt_clear (VDTGRID *pg, uint8_t clr)
+    {
+    memset (pg->clr, clr, sizeof (pg->clr));
+    memset (pg->cnt, 0, sizeof (pg->cnt));
+    }
+
+/*  Compare the rows of two grids plotted since they were last compared, then
+    clear the plot counts of those rows. Returns the number of differing pixels,
+    and the position of the first */
+int vdt_compare (VDTGRID *pg1, VDTGRID *pg2, int *px, int *py)
+    {
+    int ndiff = 0;
+    for (int yp = vdt_ymin; yp <= vdt_ymax; ++yp)
+        {
+        for (int xp = 0; xp < VDT_W; ++xp)
+            {
+            if (( pg1->clr[yp][xp] != pg2->clr[yp][xp] ) || ( pg1->cnt[yp][xp] != pg2->cnt[yp][xp] ))
+                {
+                if ( ndiff++ == 0 )
+                    {
+                    *px = xp;
+                    *py = yp;
+                    }
+                }
+            }
+        memset (pg1->cnt[yp], 0, sizeof (pg1->cnt[yp]));
+        memset (pg2->cnt[yp], 0, sizeof (pg2->cnt[yp]));
+        }
+    vdt_ymin = VDT_H;
+    vdt_ymax = -1;
+    return ndiff;
+    }
+
+static void plotpix (int clrop, int xp, int yp)
+    {
+    if (( xp < 0 ) || ( xp >= VDT_W ) || ( yp < 0 ) || ( yp >= VDT_H ))
+        {
+        ++vdt_nerr;
+        return;
+        }
+    uint8_t *pclr = &vdt_grid->clr[yp][xp];
+    uint8_t clr = clrop & vdt_cmsk;
+    switch ( clrop >> 8 )
+        {
+        case 0: *pclr = clr;                        break;
+        case 1: *pclr |= clr;                       break;
+        case 2: *pclr &= clr;                       break;
+        case 3: *pclr ^= clr;                       break;
+        case 4: *pclr = ~ *pclr & vdt_cmsk;         break;
+        }
+    ++vdt_grid->cnt[yp][xp];
+    if ( yp < vdt_ymin ) vdt_ymin = yp;
+    if ( yp > vdt_ymax ) vdt_ymax = yp;
+    }
+
+// Display driver routines:
+
+void point (int clrop, uint32_t xp, uint32_t yp)
+    {
+    ++vdt_npoint;
+    plotpix (clrop, xp, yp);
+    }
+
+void hline (int clrop, int xp1, int xp2, int yp)
+    {
+    if ( xp1 > xp2 ) ++vdt_nerr;
+    for (int xp = xp1; xp <= xp2; ++xp) plotpix (clrop, xp, yp);
+    }
+
+void hspan (int clrop, int xp1, int xp2, int yp)
+    {
+    hline (clrop, xp1, xp2, yp);
+    }
+
+void rectout (int xp1, int yp1, int xp2, int yp2)
+    {
+    }
+
+void hlbatch (bool bBatch)
+    {
+    }
+
+uint8_t getpix (int xp, int yp)
+    {
+    if (( xp < 0 ) || ( xp >= VDT_W ) || ( yp < 0 ) || ( yp >= VDT_H ))
+        {
+        ++vdt_nerr;
+        return 0;
+        }
+    return vdt_grid->clr[yp][xp];
+    }
+
+// Length of the run of pixels from xp towards xlim with colours in inset:
+int fillscan (int xp, int yp, int xlim, uint32_t inset)
+    {
+    int n = 0;
+    int dx = ( xlim >= xp ) ? 1 : -1;
+    for (int x = xp; x != xlim + dx; x += dx)
+        {
+        if (( inset & ( 1 << getpix (x, yp) )) == 0 ) break;
+        ++n;
+        }
+    return n;
+    }
+
+void hidecsr (void)
+    {
+    }
+
+void showcsr (void)
+    {
+    }
@@ -0,0 +1,33 @@
+/*  vdustub.h - Host stand-ins for the display driver and the interpreter, so that
+    vducmd.c can be included in a test program. The driver draws into a grid which
+    records the colour of each pixel and the number of times it has been plotted */
+
+#ifndef VDUSTUB_H
+#define VDUSTUB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <setjmp.h>
+
+#define VDT_W   640                     // Width of test screen (pixels)
+#define VDT_H   480                     // Height of test screen (pixels)
+
+typedef struct
+    {
+    uint8_t     clr[VDT_H][VDT_W];      // Colour of each pixel
+    uint16_t    cnt[VDT_H][VDT_W];      // Number of times each pixel plotted
+    } VDTGRID;
+
+extern VDTGRID *vdt_grid;               // Grid currently drawn into
+extern int vdt_ymin;                    // Rows plotted since vdt_clear
+extern int vdt_ymax;
+extern int vdt_nerr;                    // Driver calls outside the screen
+extern int vdt_npoint;                  // Calls of point (single pixels)
+extern uint8_t vdt_cmsk;                // Colour bits, for the GCOL actions
+extern jmp_buf *vdt_catch;              // If not NULL, error() returns here
+extern const char *vdt_errmsg;          // Message of the error caught
+
+void vdt_clear (VDTGRID *pg, uint8_t clr);
+int vdt_compare (VDTGRID *pg1, VDTGRID *pg2, int *px, int *py);
+
+#endif
@@ -386,17 +386,7 @@ static void wslcd35_ttx (uint8_t *fbuf, int xp1, int yp1, int xp2, int yp2, bool
     bool bLower = false;
     for (int yr = 0; yr < yp1; ++yr)
         {
-        uint8_t *pch = fbuf + yr * curmode.tcol;
-        bDHeight = false;
-        for (int xc = 0; xc < curmode.tcol; ++xc)
-            {
-            if ( *pch & 0x7F == 0x0D )
-                {
-                bDHeight = true;
-                break;
-                }
-            }
-        if (bDHeight) bLower = ! bLower;
+        if ( memchr (fbuf + yr * curmode.tcol, 0x0D, curmode.tcol) ) bLower = ! bLower;
         else bLower = false;
         }
     // printf ("LCD_SetWindow (%d, %d, %d, %d)\n", 8 * xscl * xp1, curmode.thgt * yscl * yp1, 8 * xscl * (xp2 + 1), curmode.thgt * yscl * (yp2 + 1));
@@ -404,6 +394,13 @@ static void wslcd35_ttx (uint8_t *fbuf, int xp1, int yp1, int xp2, int yp2, bool
         {
         uint8_t *font = ttfont;
         uint8_t *pch = fbuf + yr * curmode.tcol;
+        if (( ! bShow ) && ( yr != ycsr ) && ( memchr (pch, 0x08, curmode.tcol) == NULL ))
+            {
+            // Flash update, and nothing flashing in this row
+            if ( memchr (pch, 0x0D, curmode.tcol) ) bLower = ! bLower;
+            else bLower = false;
+            continue;
+            }
         int nfg = 7;
         uint16_t bgnd = curpal[0];
         uint16_t fgnd = curpal[nfg];
@@ -527,7 +524,8 @@ static void wslcd35_ttx (uint8_t *fbuf, int xp1, int yp1, int xp2, int yp2, bool
                     bHold = false;
                     }
                 }
-            if ((xc >= xp1) && (xc <= xp2))
+            if ((xc >= xp1) && (xc <= xp2)
+                && (bShow || bFlash || ((xc == xcsr) && (yr == ycsr))))
                 {
                 int ysr = scrltop + curmode.thgt * yscl * yr;
                 if (ysr >= nrow) ysr -= nrow;
@@ -543,7 +541,7 @@ static void wslcd35_ttx (uint8_t *fbuf, int xp1, int yp1, int xp2, int yp2, bool
                         LCD_Write_Words (bgnd, 8 * xscl * yscl);
                         // printf (" %0x%02X * %d", bgnd, 8 * xscl);
                         }
-                    else if (bShow || bFlash)
+                    else if (bShow || bFlash || ((xc == xcsr) && (yr == ycsr)))
                         {
                         for (int y = 0; y < yscl; ++y)
                             {
@@ -716,7 +714,6 @@ void mouse_config (int n, const double *xc, const double *yc)
         }
     }
 
-static PRD_FUNC pnext = NULL;
 static bool bMouseDown = false;
 
 static void mouse_periodic (void)
@@ -746,7 +743,6 @@ static void mouse_periodic (void)
             SPI_Int_Release ();
             }
         }
-    if (pnext) pnext ();
     }
 
 void mouse_init (void)
@@ -780,7 +776,7 @@ void mouse_init (void)
         // Default calibration values
         mouse_config (sizeof (defxcal) / sizeof (defxcal[0]), defxcal, defycal);
         }
-    pnext = add_periodic (mouse_periodic);
+    add_periodic (mouse_periodic, 20, 1);
     }
 
 bool brightness (const char *cmd)